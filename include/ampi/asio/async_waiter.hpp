@@ -0,0 +1,118 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_B3E10A28_8D44_4596_9E7C_421956103323
+#define UUID_B3E10A28_8D44_4596_9E7C_421956103323
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/execution/blocking.hpp>
+#include <boost/asio/execution/execute.hpp>
+#include <boost/asio/prefer.hpp>
+
+#include <cassert>
+#include <memory>
+#include <utility>
+
+namespace ampi
+{
+    namespace detail
+    {
+        // Type-erased move-only handler for completion with Args..., which is posted
+        // at most once to its associated executor, or fallback_ex if there is none.
+        template<typename... Args>
+        class erased_handler
+        {
+        public:
+            erased_handler() noexcept = default;
+
+            template<typename Handler,typename Executor = boost::asio::system_executor>
+            explicit erased_handler(Handler handler,const Executor& fallback_ex = {})
+                : impl_{std::make_unique<impl<Handler,boost::asio::associated_executor_t<
+                      Handler,Executor>>>(std::move(handler),fallback_ex)}
+            {}
+
+            explicit operator bool() const noexcept
+            {
+                return bool(impl_);
+            }
+
+            void operator()(Args... args)
+            {
+                assert(impl_);
+                auto i = std::move(impl_);
+                i->complete(std::move(args)...);
+            }
+        private:
+            struct impl_base
+            {
+                virtual ~impl_base() = default;
+                virtual void complete(Args... args) = 0;
+            };
+
+            template<typename Handler,typename Executor>
+            struct impl : impl_base
+            {
+                Handler handler_;
+                Executor ex_;
+
+                impl(Handler&& handler,const auto& fallback_ex) noexcept
+                    : handler_{std::move(handler)},
+                      ex_{boost::asio::get_associated_executor(handler_,fallback_ex)}
+                {}
+
+                void complete(Args... args) override
+                {
+                    boost::asio::execution::execute(
+                        boost::asio::prefer(std::move(ex_),boost::asio::execution::blocking.never),
+                        [handler=std::move(handler_),...args=std::move(args)]() mutable {
+                            handler(std::move(args)...);
+                        });
+                }
+            };
+
+            std::unique_ptr<impl_base> impl_;
+        };
+
+        // Holds at most one handler waiting for notify() from completion
+        // of some operation started earlier, e.g. a write in flight.
+        class async_waiter
+        {
+        public:
+            bool waiting() const noexcept
+            {
+                return bool(waiter_);
+            }
+
+            template<boost::asio::completion_token_for<void ()> CompletionToken>
+            auto async_wait(CompletionToken&& token)
+            {
+                return boost::asio::async_initiate<CompletionToken,void ()>(
+                    [this](auto handler){
+                        assert(!waiting());
+                        waiter_ = erased_handler<>{std::move(handler)};
+                    },token);
+            }
+
+            // Posts the waiting handler, if any, to its executor.
+            void notify()
+            {
+                if(waiter_)
+                    std::exchange(waiter_,{})();
+            }
+
+            // Destroys the waiting handler, if any, without calling it.
+            void cancel() noexcept
+            {
+                waiter_ = {};
+            }
+        private:
+            erased_handler<> waiter_;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,169 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_C1C713BB_AE00_4E3B_923A_3214301AD098
+#define UUID_C1C713BB_AE00_4E3B_923A_3214301AD098
+
+#include <ampi/async_msgpack.hpp>
+
+#include <boost/asio/error.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <ranges>
+
+namespace ampi
+{
+    // Encoding of a message that owns all of its data, so that it can be written
+    // to any number of streams, concurrently and after x is gone, without encoding it again.
+    // Copies share the buffers.
+    class encoded_message
+    {
+    public:
+        encoded_message() noexcept = default;
+
+        template<serializable T>
+        explicit encoded_message(const T& x)
+        {
+            detail::msgpack_chain(buffers_,x);
+            for(auto& buf:buffers_)
+                if(!buf.allocator())
+                    buf = buffer{buf.view(),{}};
+        }
+
+        const vector<cbuffer>& buffers() const noexcept
+        {
+            return buffers_;
+        }
+
+        size_t size() const noexcept
+        {
+            size_t n = 0;
+            for(auto& buf:buffers_)
+                n += buf.size();
+            return n;
+        }
+    private:
+        vector<cbuffer> buffers_;
+    };
+
+    struct broadcast_options
+    {
+        // Writes that have not finished by then are cancelled and reported
+        // with boost::asio::error::timed_out. Such streams have received part of the message
+        // and should be closed. Zero means no limit. Requires streams with cancel().
+        std::chrono::steady_clock::duration timeout{};
+        // Called with the index of each stream and the result of its write once it finishes,
+        // on the executor of the stream.
+        std::function<void (size_t,boost::system::error_code)> on_written;
+    };
+
+    namespace detail
+    {
+        template<typename AsyncWriteStream>
+        class broadcast_op : public std::enable_shared_from_this<broadcast_op<AsyncWriteStream>>
+        {
+        public:
+            broadcast_op(encoded_message msg,size_t n,broadcast_options options,
+                         erased_handler<vector<boost::system::error_code>> handler)
+                : msg_{std::move(msg)},
+                  options_{std::move(options)},
+                  handler_{std::move(handler)},
+                  targets_{std::make_unique<target[]>(n)},
+                  results_(n),
+                  remaining_{n}
+            {}
+
+            // Has to be called on the executor of the stream.
+            void start(size_t i,AsyncWriteStream& stream)
+            {
+                target& t = targets_[i];
+                if constexpr(requires(boost::system::error_code ec){ stream.cancel(ec); })
+                    if(options_.timeout!=options_.timeout.zero()){
+                        t.timer.emplace(stream.get_executor(),options_.timeout);
+                        t.timer->async_wait([self=this->shared_from_this(),&t,&stream]
+                                (boost::system::error_code ec){
+                            if(ec||t.done)
+                                return;
+                            t.timed_out = true;
+                            boost::system::error_code cancel_ec;
+                            stream.cancel(cancel_ec);
+                        });
+                    }
+                boost::asio::async_write(stream,msg_.buffers(),
+                    [self=this->shared_from_this(),i](boost::system::error_code ec,size_t /*n*/){
+                        self->finish(i,ec);
+                    });
+            }
+        private:
+            struct target
+            {
+                optional<boost::asio::steady_timer> timer;
+                bool done = false,timed_out = false;
+            };
+
+            encoded_message msg_;
+            broadcast_options options_;
+            erased_handler<vector<boost::system::error_code>> handler_;
+            std::unique_ptr<target[]> targets_;
+            vector<boost::system::error_code> results_;
+            std::atomic<size_t> remaining_;
+
+            void finish(size_t i,boost::system::error_code ec)
+            {
+                target& t = targets_[i];
+                t.done = true;
+                if(t.timer)
+                    t.timer->cancel();
+                if(t.timed_out)
+                    ec = boost::asio::error::timed_out;
+                results_[i] = ec;
+                if(options_.on_written)
+                    options_.on_written(i,ec);
+                if(remaining_.fetch_sub(1,std::memory_order::acq_rel)==1)
+                    handler_(std::move(results_));
+            }
+        };
+    }
+
+    // Writes msg to every stream of streams, a range of pointers to streams that may run
+    // on different executors, sharing its buffers between all of the writes.
+    // Completes with results of writes in order of streams once all of them finish.
+    // Streams have to stay alive and otherwise unwritten until then.
+    template<std::ranges::random_access_range Streams,
+             typename AsyncWriteStream = std::remove_pointer_t<std::ranges::range_value_t<Streams>>,
+             boost::asio::completion_token_for<void (vector<boost::system::error_code>)>
+                 CompletionToken = boost::asio::default_completion_token_t<
+                     typename boost::asio::associated_executor<AsyncWriteStream>::type>>
+        requires std::is_pointer_v<std::ranges::range_value_t<Streams>>
+    auto async_broadcast(const Streams& streams,const encoded_message& msg,
+                         broadcast_options options = {},CompletionToken&& token = {})
+    {
+        return boost::asio::async_initiate<CompletionToken,
+                                           void (vector<boost::system::error_code>)>(
+            [](auto handler,const Streams& streams,const encoded_message& msg,
+                    broadcast_options options){
+                size_t n = std::ranges::size(streams);
+                if(!n){
+                    detail::erased_handler<vector<boost::system::error_code>>{std::move(handler)}({});
+                    return;
+                }
+                auto op = std::make_shared<detail::broadcast_op<AsyncWriteStream>>(
+                    msg,n,std::move(options),
+                    detail::erased_handler<vector<boost::system::error_code>>{
+                        std::move(handler),streams[0]->get_executor()});
+                for(size_t i=0;i<n;++i)
+                    boost::asio::post(streams[i]->get_executor(),[op,i,&stream = *streams[i]]{
+                        op->start(i,stream);
+                    });
+            },token,streams,msg,std::move(options));
+    }
+}
+
+#endif
@@ -7,12 +7,23 @@
 #ifndef UUID_2FDAA7EA_A48D_4BAD_B5B7_A60108498A10
 #define UUID_2FDAA7EA_A48D_4BAD_B5B7_A60108498A10
 
+#include <ampi/asio/async_waiter.hpp>
 #include <ampi/buffer_sinks/async_stream_buffer_sink.hpp>
+#include <ampi/buffer_sinks/container_buffer_sink.hpp>
 #include <ampi/detail/msgpack_ctx_base.hpp>
 #include <ampi/event_sources/event_source.hpp>
 #include <ampi/filters/emitter.hpp>
 #include <ampi/pmr/reusable_monotonic_buffer_resource.hpp>
 
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <array>
+#include <chrono>
+#include <iterator>
+#include <limits>
+#include <mutex>
+
 namespace ampi
 {
     namespace detail
@@ -34,6 +45,21 @@ namespace ampi
         private:
             reusable_monotonic_buffer_resource& mbr_;
         };
+
+        // Encodes x into buffers appended to chain. Large data pieces of x
+        // are referenced instead of copied. Chains are kept while queued, so chunks
+        // start small and grow to the default size, keeping small messages small.
+        template<serializable T>
+        void msgpack_chain(auto& chain,const T& x)
+        {
+            stack_executor_ctx ctx;
+            auto ses = serial_event_source(type_tag<T>)(ctx.ex,x);
+            pmr_buffer_factory pbf;
+            growing_buffer_factory bf{pbf,default_packing_chunk_size};
+            auto em = packing_emitter(ctx.ex,ses,bf,default_packing_inline_threshold);
+            auto sink = chain_buffer_sink(ctx.ex,chain,em).assume_blocking();
+            sink();
+        }
     }
 
     template<typename AsyncWriteStream,typename IOVec = default_iovec_t>
@@ -44,7 +70,7 @@ namespace ampi
                 IOVec iovec = {}) noexcept
             : msgpack_ctx_base{std::move(ssr)},
               stream_{&stream},
-              iovec_{iovec,mbr_}
+              iovecs_{{{iovec,mbrs_[0]},{iovec,mbrs_[1]}}}
         {}
 
         template<serializable T,
@@ -53,19 +79,22 @@ namespace ampi
                      typename boost::asio::associated_executor<AsyncWriteStream>::type>>
         auto async_msgpack(const T& x,CompletionToken&& token = {})
         {
-            mbr_.reuse();
             return [](executor auto,async_stream_msgpack_ctx& this_,const T& x)
                     -> coroutine<void,typename boost::asio::associated_executor<AsyncWriteStream>::type> {
                 auto ses = serial_event_source(type_tag<T>)(this_.ctx_.ex,x);
-                auto em = emitter(this_.ctx_.ex,ses,this_.bf_);
-                co_await async_stream_buffer_sink(*this_.stream_,em,this_.iovec_);
+                auto em = packing_emitter(this_.ctx_.ex,ses,this_.bf_);
+                co_await async_stream_double_buffer_sink(*this_.stream_,em,this_.iovecs_,
+                    [&this_](size_t i){
+                        this_.bf_ = pmr_buffer_factory{&this_.mbrs_[i]};
+                    });
             }(stream_->get_executor(),*this,x).async_run(std::forward<CompletionToken>(token));
         }
     private:
         AsyncWriteStream* stream_;
-        reusable_monotonic_buffer_resource mbr_;
-        pmr_buffer_factory bf_{&mbr_};
-        detail::reusing_iovec_t<IOVec> iovec_;
+        // Buffers of one iovec are being written while the other one is filled.
+        std::array<reusable_monotonic_buffer_resource,2> mbrs_;
+        pmr_buffer_factory bf_{&mbrs_[0]};
+        std::array<detail::reusing_iovec_t<IOVec>,2> iovecs_;
     };
 
     template<typename AsyncWriteStream,serializable T,
@@ -78,13 +107,212 @@ namespace ampi
                 -> coroutine<void,typename boost::asio::associated_executor<AsyncWriteStream>::type> {
             detail::stack_executor_ctx ctx;
             auto ses = serial_event_source(type_tag<T>)(ctx.ex,x);
-            reusable_monotonic_buffer_resource mr;
-            pmr_buffer_factory bf{&mr};
-            auto em = emitter(ctx.ex,ses,bf);
-            detail::reusing_iovec_t<default_iovec_t> iovec{{},mr};
-            co_await async_stream_buffer_sink(stream,em,iovec);
+            std::array<reusable_monotonic_buffer_resource,2> mrs;
+            pmr_buffer_factory bf{&mrs[0]};
+            auto em = packing_emitter(ctx.ex,ses,bf);
+            std::array<detail::reusing_iovec_t<default_iovec_t>,2> iovecs{{{{},mrs[0]},{{},mrs[1]}}};
+            co_await async_stream_double_buffer_sink(stream,em,iovecs,[&](size_t i){
+                bf = pmr_buffer_factory{&mrs[i]};
+            });
         }(stream.get_executor(),stream,x).async_run(std::forward<CompletionToken>(token));
     }
+
+    // Limits on how long messages queued in async_stream_msgpack_writer may wait for others
+    // to be written together with them. They are flushed once they take max_bytes
+    // or max_messages, or the oldest of them has waited for max_delay.
+    // The defaults flush whenever the stream is free.
+    struct flush_policy
+    {
+        size_t max_bytes = std::numeric_limits<size_t>::max(),
+               max_messages = std::numeric_limits<size_t>::max();
+        std::chrono::microseconds max_delay{0};
+    };
+
+    // Numbers of flushes by the condition that started them.
+    struct flush_statistics
+    {
+        uint64_t bytes = 0,messages = 0,deadline = 0,requested = 0;
+    };
+
+    // Shares one stream between senders on any threads. Each message is encoded
+    // on the thread of its sender and queued, queued messages go out in order of queueing
+    // with one gathered write when the policy says so and no write is in flight,
+    // and handlers complete once the write with their message has. Like with async_msgpack,
+    // x has to stay alive until completion. The writer has to outlive its operations.
+    template<typename AsyncWriteStream>
+    class async_stream_msgpack_writer
+    {
+    public:
+        using executor_type = typename boost::asio::associated_executor<AsyncWriteStream>::type;
+
+        explicit async_stream_msgpack_writer(AsyncWriteStream& stream,flush_policy policy = {})
+            : stream_{&stream},
+              policy_{policy},
+              timer_{stream.get_executor()}
+        {}
+
+        executor_type get_executor() const noexcept
+        {
+            return stream_->get_executor();
+        }
+
+        template<serializable T,
+                 boost::asio::completion_token_for<void (result<void>)> CompletionToken =
+                 boost::asio::default_completion_token_t<executor_type>>
+        auto async_msgpack(const T& x,CompletionToken&& token = {})
+        {
+            return boost::asio::async_initiate<CompletionToken,void (result<void>)>(
+                [this](auto handler,const T& x){
+                    handler_t h{std::move(handler),get_executor()};
+                    vector<cbuffer> chain;
+                    try{
+                        detail::msgpack_chain(chain,x);
+                    }
+                    catch(...){
+                        h(boost::outcome_v2::failure(std::current_exception()));
+                        return;
+                    }
+                    enqueue(chain,std::move(h));
+                },token,x);
+        }
+
+        // Flushes messages queued so far regardless of the policy.
+        void flush()
+        {
+            std::unique_lock lock{mutex_};
+            if(queued_.handlers.empty())
+                return;
+            requested_ = true;
+            schedule(lock);
+        }
+
+        flush_statistics stats() const
+        {
+            std::lock_guard lock{mutex_};
+            return stats_;
+        }
+    private:
+        using handler_t = detail::erased_handler<result<void>>;
+        using clock = std::chrono::steady_clock;
+
+        struct batch
+        {
+            vector<cbuffer> buffers;
+            vector<handler_t> handlers;
+
+            void swap(batch& other) noexcept
+            {
+                buffers.swap(other.buffers);
+                handlers.swap(other.handlers);
+            }
+        };
+
+        AsyncWriteStream* stream_;
+        flush_policy policy_;
+        boost::asio::steady_timer timer_;
+        mutable std::mutex mutex_;
+        // Guarded by mutex_.
+        batch queued_;
+        size_t queued_bytes_ = 0;
+        clock::time_point oldest_;
+        bool flushing_ = false,waiting_ = false,requested_ = false;
+        flush_statistics stats_;
+        // Only used on the executor.
+        batch writing_;
+
+        void enqueue(vector<cbuffer>& chain,handler_t h)
+        {
+            size_t n = 0;
+            for(auto& buf:chain)
+                n += buf.size();
+            std::unique_lock lock{mutex_};
+            if(queued_.handlers.empty())
+                oldest_ = clock::now();
+            queued_.buffers.insert(queued_.buffers.end(),
+                                   std::make_move_iterator(chain.begin()),
+                                   std::make_move_iterator(chain.end()));
+            queued_.handlers.push_back(std::move(h));
+            queued_bytes_ += n;
+            schedule(lock);
+        }
+
+        // Counter of the reason for flushing the queue now, if there is one.
+        uint64_t* due() noexcept
+        {
+            if(queued_.handlers.empty())
+                return nullptr;
+            if(requested_)
+                return &stats_.requested;
+            if(queued_bytes_>=policy_.max_bytes)
+                return &stats_.bytes;
+            if(queued_.handlers.size()>=policy_.max_messages)
+                return &stats_.messages;
+            if(clock::now()-oldest_>=policy_.max_delay)
+                return &stats_.deadline;
+            return nullptr;
+        }
+
+        // Starts a write if it is due and none is in flight, or else
+        // a wait for the deadline of the queue if there is none yet.
+        void schedule(std::unique_lock<std::mutex>& lock)
+        {
+            if(flushing_||queued_.handlers.empty())
+                return;
+            if(due()){
+                flushing_ = true;
+                lock.unlock();
+                boost::asio::post(get_executor(),[this]{
+                    write();
+                });
+            }else if(!waiting_){
+                waiting_ = true;
+                clock::time_point deadline = oldest_+policy_.max_delay;
+                lock.unlock();
+                boost::asio::post(get_executor(),[this,deadline]{
+                    wait(deadline);
+                });
+            }
+        }
+
+        void wait(clock::time_point deadline)
+        {
+            timer_.expires_at(deadline);
+            timer_.async_wait([this](boost::system::error_code ec){
+                // The writer is being destroyed.
+                if(ec==boost::asio::error::operation_aborted)
+                    return;
+                std::unique_lock lock{mutex_};
+                waiting_ = false;
+                schedule(lock);
+            });
+        }
+
+        void write()
+        {
+            {
+                std::lock_guard lock{mutex_};
+                // Conditions stay true until the queue is taken.
+                ++*due();
+                queued_.swap(writing_);
+                queued_bytes_ = 0;
+                requested_ = false;
+            }
+            boost::asio::async_write(*stream_,writing_.buffers,
+                [this](boost::system::error_code ec,size_t /*n*/){
+                    for(auto& h:writing_.handlers)
+                        if(ec)
+                            h(boost::outcome_v2::failure(
+                                std::make_exception_ptr(boost::system::system_error(ec))));
+                        else
+                            h(boost::outcome_v2::success());
+                    writing_.buffers.clear();
+                    writing_.handlers.clear();
+                    std::unique_lock lock{mutex_};
+                    flushing_ = false;
+                    schedule(lock);
+                });
+        }
+    };
 }
 
 #endif
@@ -35,8 +35,15 @@ namespace ampi
         {
             return [](executor auto,async_stream_msgunpack_ctx& this_,T& x)
                     -> coroutine<void,typename boost::asio::associated_executor<AsyncReadStream>::type> {
-                auto p_v = this_.p();
-                co_await serial_event_sink(type_tag<T>)(this_.ctx_.ex,p_v,x);
+                try{
+                    if(this_.start_object())
+                        co_await this_.skip_rest();
+                    co_await serial_event_sink(type_tag<T>)(this_.ctx_.ex,this_.source_,x);
+                }
+                catch(const parser_error&){
+                    this_.parser_failed();
+                    throw;
+                }
             }(this->p_.get_executor(),*this,x).
                 async_run(std::forward<CompletionToken>(token));
         }
@@ -55,7 +62,8 @@ namespace ampi
             auto asbs = async_stream_buffer_source<readahead_t::none>(stream,bf);
             parser p{asbs,bf,{},ctx.ex};
             auto p_v = p();
-            co_await serial_event_sink(type_tag<T>)(ctx.ex,p_v,x);
+            parser_event_source pes{p,p_v};
+            co_await serial_event_sink(type_tag<T>)(ctx.ex,pes,x);
         }(stream.get_executor(),stream,x).
             async_run(std::forward<CompletionToken>(token));
     }
@@ -7,24 +7,31 @@
 #ifndef UUID_49537D96_1C5A_4CAC_985E_5DE7C3FA0D59
 #define UUID_49537D96_1C5A_4CAC_985E_5DE7C3FA0D59
 
+#include <ampi/pmr/buffer_pool_resource.hpp>
 #include <ampi/vocabulary.hpp>
 
 #include <boost/algorithm/hex.hpp>
 #include <boost/asio/buffer.hpp>
-#include <boost/smart_ptr/intrusive_ptr.hpp>
-#include <boost/smart_ptr/intrusive_ref_counter.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <limits>
 #include <new>
 #include <span>
+#include <stdexcept>
 #include <utility>
 
 namespace ampi
 {
     namespace detail
     {
-        struct buffer_header : public boost::intrusive_ref_counter<buffer_header>
+        struct buffer_header
         {
+            std::atomic<unsigned> refcount_ = 0;
+            // Set for buffers that never cross threads, whose references are then
+            // counted without atomic read-modify-write operations.
+            bool single_threaded_ = false;
             size_t capacity_;
             shared_polymorphic_allocator<> spa_;
 
@@ -33,6 +40,30 @@ namespace ampi
                   spa_{std::move(spa)}
             {}
 
+            friend void intrusive_ptr_add_ref(buffer_header* p) noexcept
+            {
+                if(p->single_threaded_)
+                    p->refcount_.store(p->refcount_.load(std::memory_order::relaxed)+1,
+                                       std::memory_order::relaxed);
+                else
+                    p->refcount_.fetch_add(1,std::memory_order::relaxed);
+            }
+
+            friend void intrusive_ptr_release(buffer_header* p) noexcept
+            {
+                unsigned n = p->refcount_.load(std::memory_order::relaxed);
+                if(p->single_threaded_){
+                    p->refcount_.store(--n,std::memory_order::relaxed);
+                    if(n)
+                        return;
+                }else{
+                    if(n!=1&&p->refcount_.fetch_sub(1,std::memory_order::release)!=1)
+                        return;
+                    std::atomic_thread_fence(std::memory_order::acquire);
+                }
+                delete p;
+            }
+
             void operator delete(buffer_header* p,std::destroying_delete_t)
             {
                 auto spa = std::move(p->spa_);
@@ -45,66 +76,99 @@ namespace ampi
 
     class cbuffer
     {
+        constexpr static uint32_t unowned = std::numeric_limits<uint32_t>::max();
     public:
+        // Offsets and sizes are kept in 32 bits to fit buffers in 16 bytes.
+        constexpr static size_t max_size = unowned-1;
+
         cbuffer() noexcept = default;
 
-        cbuffer(const cbuffer& other) noexcept = default;
-        cbuffer& operator=(const cbuffer& other) noexcept = default;
+        cbuffer(const cbuffer& other) noexcept
+            : p_{other.p_},
+              offset_{other.offset_},
+              size_{other.size_}
+        {
+            if(auto h = header())
+                intrusive_ptr_add_ref(h);
+        }
+
+        cbuffer& operator=(const cbuffer& other) noexcept
+        {
+            cbuffer{other}.swap(*this);
+            return *this;
+        }
 
         cbuffer(cbuffer&& other) noexcept
-            : header_{std::move(other.header_)},
-              view_{std::exchange(other.view_,{})}
+            : p_{std::exchange(other.p_,nullptr)},
+              offset_{std::exchange(other.offset_,unowned)},
+              size_{std::exchange(other.size_,0)}
         {}
 
         cbuffer& operator=(cbuffer&& other) noexcept
         {
-            if(this!=&other){
-                header_ = std::move(other.header_);
-                view_ = std::exchange(other.view_,{});
-            }
+            cbuffer{std::move(other)}.swap(*this);
             return *this;
         }
 
-        cbuffer(binary_cview_t bv) noexcept
-            : header_{},
-              view_{const_cast<std::byte*>(bv.data()),bv.size()}
-        {}
+        ~cbuffer()
+        {
+            if(auto h = header())
+                intrusive_ptr_release(h);
+        }
 
-        cbuffer(cbuffer& other,size_t offset,size_t count = std::dynamic_extent) noexcept
-            : header_{other.header_},
-              view_{other.view_.subspan(offset,count)}
-        {}
+        // Throws std::length_error for views over max_size. Such views are split into several
+        // buffers by one_buffer_source.
+        cbuffer(binary_cview_t bv)
+            : p_{const_cast<std::byte*>(bv.data())},
+              size_{uint32_t(bv.size())}
+        {
+            if(bv.size()>max_size)
+                throw std::length_error{"ampi::cbuffer: view is too large"};
+        }
+
+        cbuffer(const cbuffer& other,size_t offset,size_t count = std::dynamic_extent) noexcept
+            : cbuffer{other}
+        {
+            narrow(offset,count);
+        }
 
         cbuffer(cbuffer&& other,size_t offset,size_t count = std::dynamic_extent) noexcept
-            : header_{std::move(other.header_)},
-              view_{other.view_.subspan(offset,count)}
+            : cbuffer{std::move(other)}
+        {
+            narrow(offset,count);
+        }
+
+        void swap(cbuffer& other) noexcept
         {
-            other.view_ = {};
+            std::swap(p_,other.p_);
+            std::swap(offset_,other.offset_);
+            std::swap(size_,other.size_);
         }
 
         const shared_polymorphic_allocator<>* allocator() const noexcept
         {
-            return header_?&header_->spa_:nullptr;
+            auto h = header();
+            return h?&h->spa_:nullptr;
         }
 
         explicit operator bool() const noexcept
         {
-            return view_.size();
+            return size_;
         }
 
         size_t size() const noexcept
         {
-            return view_.size();
+            return size_;
         }
 
         const byte* data() const noexcept
         {
-            return view_.data();
+            return mutable_data();
         }
 
         binary_cview_t view() const noexcept
         {
-            return view_;
+            return {data(),size()};
         }
 
         operator boost::asio::const_buffer() const noexcept
@@ -114,22 +178,29 @@ namespace ampi
 
         byte operator[](size_t i) const noexcept
         {
-            return view_[i];
+            assert(i<size_);
+            return data()[i];
         }
 
         const byte* begin() const noexcept
         {
-            return view_.data();
+            return data();
         }
 
         const byte* end() const noexcept
         {
-            return view_.data()+view_.size();
+            return data()+size_;
+        }
+
+        // View of the same data that doesn't own it.
+        cbuffer borrowed() const noexcept
+        {
+            return view();
         }
 
         bool append(cbuffer& other) noexcept
         {
-            if(header_&&other.header_)
+            if(header()&&other.header())
                 return false;
             if(!other)
                 return true;
@@ -137,12 +208,17 @@ namespace ampi
                 *this = std::move(other);
                 return true;
             }
-            if(end()!=other.begin())
+            if(end()!=other.begin()||size_t(size_)+other.size_>max_size)
                 return false;
-            view_ = {view_.data(),view_.size()+other.view_.size()};
-            other.view_ = {};
-            if(!header_)
-                header_ = std::move(other.header_);
+            if(other.header()){
+                // Owned data is addressed relative to the header, which has to precede it.
+                if(other.offset_<size_)
+                    return false;
+                p_ = std::exchange(other.p_,nullptr);
+                offset_ = std::exchange(other.offset_,unowned)-size_;
+            }
+            size_ += std::exchange(other.size_,0);
+            other.p_ = nullptr;
             return true;
         }
 
@@ -154,16 +230,45 @@ namespace ampi
             return stream;
         }
     protected:
-        boost::intrusive_ptr<detail::buffer_header> header_;
-        binary_view_t view_;
+        // Header of owned buffers, whose data follows it, or data of unowned ones.
+        void* p_ = nullptr;
+        uint32_t offset_ = unowned,size_ = 0;
+
+        cbuffer(detail::buffer_header* header) noexcept
+            : p_{header},
+              offset_{0},
+              size_{uint32_t(header->capacity_)}
+        {
+            assert(header->capacity_<=max_size);
+            intrusive_ptr_add_ref(header);
+        }
 
-        cbuffer(boost::intrusive_ptr<detail::buffer_header> header) noexcept
-            : header_{std::move(header)},
-              view_{reinterpret_cast<byte*>(header_.get())+sizeof(detail::buffer_header),
-                    header_->capacity_}
-        {}
+        detail::buffer_header* header() const noexcept
+        {
+            return offset_==unowned?nullptr:static_cast<detail::buffer_header*>(p_);
+        }
+
+        byte* mutable_data() const noexcept
+        {
+            return offset_==unowned?static_cast<byte*>(p_):
+                static_cast<byte*>(p_)+sizeof(detail::buffer_header)+offset_;
+        }
+
+        void narrow(size_t offset,size_t count) noexcept
+        {
+            assert(offset<=size_&&(count==std::dynamic_extent||count<=size_-offset));
+            if(offset_==unowned)
+                p_ = static_cast<byte*>(p_)+offset;
+            else
+                offset_ += uint32_t(offset);
+            size_ = uint32_t(count==std::dynamic_extent?size_-offset:count);
+        }
+    private:
+        friend class mapped_file;
     };
 
+    static_assert(sizeof(cbuffer)==16);
+
     class buffer : public cbuffer
     {
     public:
@@ -171,15 +276,12 @@ namespace ampi
 
         buffer() noexcept = default;
 
-        buffer(binary_view_t bv) noexcept
+        buffer(binary_view_t bv)
             : cbuffer{bv}
         {}
 
         explicit buffer(size_t n,shared_polymorphic_allocator<> spa = {})
-            : buffer{spa.is_trivially_deallocatable()?
-                  buffer{{static_cast<byte*>(spa.allocate_bytes(n)),n}}:
-                  buffer{::new (spa.allocate_bytes(sizeof(detail::buffer_header)+n,
-                      alignof(detail::buffer_header))) detail::buffer_header{n,std::move(spa)}}}
+            : buffer{allocate(n,std::move(spa))}
         {
             assert(n);
         }
@@ -203,14 +305,14 @@ namespace ampi
 
         byte* data() const noexcept
         {
-            return view_.data();
+            return mutable_data();
         }
 
         using cbuffer::view;
 
         binary_view_t view() noexcept
         {
-            return view_;
+            return {data(),size()};
         }
 
         operator boost::asio::mutable_buffer() noexcept
@@ -222,31 +324,52 @@ namespace ampi
 
         byte& operator[](size_t i) noexcept
         {
-            return view_[i];
+            assert(i<size());
+            return data()[i];
         }
 
         using cbuffer::begin;
 
         byte* begin() noexcept
         {
-            return view_.data();
+            return data();
         }
 
         using cbuffer::end;
 
         byte* end() noexcept
         {
-            return view_.data()+view_.size();
+            return data()+size();
         }
 
         bool append(buffer& other) noexcept
         {
             return cbuffer::append(other);
         }
+
+        // Only allowed while there are no other references to the buffer.
+        void set_single_threaded() noexcept
+        {
+            if(auto h = header()){
+                assert(h->refcount_.load(std::memory_order::relaxed)==1);
+                h->single_threaded_ = true;
+            }
+        }
     private:
-        buffer(boost::intrusive_ptr<detail::buffer_header> header) noexcept
+        buffer(detail::buffer_header* header) noexcept
             : cbuffer{header}
         {}
+
+        // Checks n first, so that nothing is allocated for sizes that can't be represented.
+        static buffer allocate(size_t n,shared_polymorphic_allocator<>&& spa)
+        {
+            if(n>max_size)
+                throw std::length_error{"ampi::buffer: size is too large"};
+            if(spa.is_trivially_deallocatable())
+                return buffer{{static_cast<byte*>(spa.allocate_bytes(n)),n}};
+            return buffer{::new (spa.allocate_bytes(sizeof(detail::buffer_header)+n,
+                alignof(detail::buffer_header))) detail::buffer_header{n,std::move(spa)}};
+        }
     };
 
     template<typename T>
@@ -256,6 +379,58 @@ namespace ampi
         bf.next_buffer_size(n);
     };
 
+    // Makes buffers of another factory single-threaded, for pipelines
+    // that never pass them or anything sliced from them to other threads.
+    template<buffer_factory BufferFactory>
+    class single_threaded_buffer_factory
+    {
+    public:
+        explicit single_threaded_buffer_factory(BufferFactory& bf) noexcept
+            : bf_{bf}
+        {}
+
+        buffer get_buffer(size_t size = 0)
+        {
+            buffer buf = bf_.get_buffer(size);
+            buf.set_single_threaded();
+            return buf;
+        }
+
+        void next_buffer_size(size_t n) noexcept
+        {
+            bf_.next_buffer_size(n);
+        }
+    private:
+        BufferFactory& bf_;
+    };
+
+    // Hands out buffers of another factory twice as large as the previous ones,
+    // up to limit, so that short outputs take small buffers without knowing their size upfront.
+    template<buffer_factory BufferFactory>
+    class growing_buffer_factory
+    {
+    public:
+        growing_buffer_factory(BufferFactory& bf,size_t limit) noexcept
+            : bf_{bf},
+              limit_{limit}
+        {}
+
+        buffer get_buffer(size_t size = 0)
+        {
+            size = std::max(size,next_);
+            next_ = std::min(size*2,limit_);
+            return bf_.get_buffer(size);
+        }
+
+        void next_buffer_size(size_t n) noexcept
+        {
+            bf_.next_buffer_size(n);
+        }
+    private:
+        BufferFactory& bf_;
+        size_t limit_,next_ = 0;
+    };
+
     class null_buffer_factory
     {
     public:
@@ -297,6 +472,45 @@ namespace ampi
         shared_polymorphic_allocator<> spa_;
         size_t default_buffer_size_,next_buffer_size_ = 0;
     };
+
+    // Recycles memory of buffers through a buffer_pool_resource shared with them,
+    // so that it outlives the factory while there are buffers to return to it.
+    // Must be used on one thread, buffers may be released on any thread.
+    class pooled_buffer_factory
+    {
+    public:
+        explicit pooled_buffer_factory(size_t default_buffer_size =
+                    pmr_buffer_factory::default_default_buffer_size,
+                boost::container::pmr::memory_resource* upstream =
+                    boost::container::pmr::get_default_resource())
+            : spa_{std::in_place_type<buffer_pool_resource>,upstream},
+              default_buffer_size_{default_buffer_size}
+        {}
+
+        buffer get_buffer(size_t size = 0)
+        {
+            constexpr size_t h = sizeof(detail::buffer_header);
+            size_t n = std::max(size,std::exchange(next_buffer_size_,0));
+            // Buffers span whole blocks, header included, and the default size is that of a block.
+            n = n?n+h:default_buffer_size_;
+            if(n<=buffer_pool_resource::max_block_size)
+                n = buffer_pool_resource::block_size(n);
+            return buffer{n-h,spa_};
+        }
+
+        void next_buffer_size(size_t n) noexcept
+        {
+            next_buffer_size_ = n;
+        }
+
+        buffer_pool_resource::statistics stats() const noexcept
+        {
+            return static_cast<buffer_pool_resource*>(spa_.resource())->stats();
+        }
+    private:
+        shared_polymorphic_allocator<> spa_;
+        size_t default_buffer_size_,next_buffer_size_ = 0;
+    };
 }
 
 #endif
@@ -7,11 +7,16 @@
 #ifndef UUID_5E84D5A1_AA30_42B1_8AD3_D4A000BCA4EA
 #define UUID_5E84D5A1_AA30_42B1_8AD3_D4A000BCA4EA
 
+#include <ampi/asio/async_waiter.hpp>
 #include <ampi/buffer_sources/buffer_source.hpp>
 #include <ampi/coro/use_coroutine.hpp>
 
 #include <boost/asio/write.hpp>
 #include <boost/container/static_vector.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <array>
+#include <exception>
 
 namespace ampi
 {
@@ -45,6 +50,72 @@ namespace ampi
     {
         return async_stream_buffer_sink(stream.get_executor(),stream,bs,iovec);
     }
+
+    // Keeps filling one of two iovecs while the other one is being written.
+    // on_switch(i) is called whenever filling moves to iovecs[i], after it was cleared,
+    // so that buffer factories of the source can switch to memory of that iovec.
+    // Relies on the source having yielded all buffers it allocated at each of its
+    // suspension points, which holds for emitters. Has to run on the executor of the stream
+    // and must not be destroyed while suspended.
+    template<executor Executor,typename AsyncWriteStream,typename IOVec>
+    coroutine<void,Executor> async_stream_double_buffer_sink(Executor /*ex*/,AsyncWriteStream& stream,
+            buffer_source auto& bs,std::array<IOVec,2>& iovecs,auto on_switch)
+    {
+        size_t i = 0;
+        bool writing = false;
+        boost::system::error_code ec;
+        detail::async_waiter waiter;
+        for(auto& iovec:iovecs)
+            iovec.clear();
+        on_switch(i);
+        std::exception_ptr e;
+        try{
+            while(auto buf = co_await bs){
+                auto& iovec = iovecs[i];
+                if(iovec.empty()||!iovec.back().append(*buf)){
+                    iovec.emplace_back(std::move(*buf));
+                    if(iovec.size()==iovec.capacity()){
+                        if(writing)
+                            co_await waiter.async_wait(use_coroutine);
+                        if(ec)
+                            throw boost::system::system_error(ec);
+                        writing = true;
+                        boost::asio::async_write(stream,iovec,
+                            [&](boost::system::error_code write_ec,size_t /*n*/){
+                                ec = write_ec;
+                                writing = false;
+                                waiter.notify();
+                            });
+                        i ^= 1;
+                        iovecs[i].clear();
+                        on_switch(i);
+                    }
+                }
+            }
+        }
+        catch(...){
+            e = std::current_exception();
+        }
+        // The write in flight refers to this frame.
+        if(writing)
+            co_await waiter.async_wait(use_coroutine);
+        if(e)
+            std::rethrow_exception(e);
+        if(ec)
+            throw boost::system::system_error(ec);
+        co_await boost::asio::async_write(stream,iovecs[i],use_coroutine);
+        for(auto& iovec:iovecs)
+            iovec.clear();
+    }
+
+    template<typename AsyncWriteStream,typename IOVec>
+    auto async_stream_double_buffer_sink(AsyncWriteStream& stream,buffer_source auto& bs,
+                                         std::array<IOVec,2>& iovecs,auto on_switch)
+        -> coroutine<void,decltype(stream.get_executor())>
+    {
+        return async_stream_double_buffer_sink(stream.get_executor(),stream,bs,iovecs,
+                                               std::move(on_switch));
+    }
 }
 
 #endif
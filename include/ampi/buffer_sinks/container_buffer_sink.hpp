@@ -22,6 +22,20 @@ namespace ampi
     {
         return container_buffer_sink(boost::asio::system_executor{},cont,bs);
     }
+
+    // Keeps the buffers themselves in chain, merging adjacent ones, instead of copying their data.
+    template<executor Executor>
+    coroutine<void,Executor> chain_buffer_sink(Executor /*ex*/,auto& chain,buffer_source auto& bs)
+    {
+        while(auto buf = co_await bs)
+            if(chain.empty()||!chain.back().append(*buf))
+                chain.push_back(std::move(*buf));
+    }
+
+    coroutine<> chain_buffer_sink(auto& chain,buffer_source auto& bs)
+    {
+        return chain_buffer_sink(boost::asio::system_executor{},chain,bs);
+    }
 }
 
 #endif
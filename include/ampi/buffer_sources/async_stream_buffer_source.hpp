@@ -8,12 +8,17 @@
 #define UUID_41E57842_C9B6_4BFC_AB6E_9BE046FD20B1
 
 #include <ampi/asio/as_tuple.hpp>
+#include <ampi/asio/async_waiter.hpp>
 #include <ampi/buffer_sources/buffer_source.hpp>
 #include <ampi/coro/use_coroutine.hpp>
 
 #include <boost/asio/read.hpp>
 #include <boost/system/system_error.hpp>
 
+#include <algorithm>
+#include <deque>
+#include <memory>
+
 namespace ampi
 {
     template<typename T>
@@ -22,12 +27,84 @@ namespace ampi
         { stream.available() } -> std::convertible_to<size_t>;
     };
 
+    template<typename T>
+    concept readahead_adaptive_stream = readahead_available_stream<T>&&
+        requires(T stream,boost::system::error_code ec){
+            stream.non_blocking(true);
+            { stream.non_blocking() } -> std::convertible_to<bool>;
+            stream.non_blocking(true,ec);
+            { stream.read_some(boost::asio::mutable_buffer{},ec) } -> std::convertible_to<size_t>;
+        };
+
+    template<readahead_t ReadAhead,typename AsyncReadStream>
+    concept readahead_supported_stream = ReadAhead==readahead_t::none||
+        (ReadAhead==readahead_t::available&&readahead_available_stream<AsyncReadStream>)||
+        (ReadAhead==readahead_t::adaptive&&readahead_adaptive_stream<AsyncReadStream>);
+
+    namespace detail
+    {
+        // Sizes speculative reads at twice the moving average of what they returned,
+        // doubling them while they keep filling buffers up.
+        class adaptive_readahead
+        {
+        public:
+            constexpr static size_t min_size = 0x1000,
+                                    max_size = 0x400000;
+
+            size_t size() const noexcept
+            {
+                return size_;
+            }
+
+            void update(size_t n,size_t capacity) noexcept
+            {
+                average_ = (average_*3+n)/4;
+                size_ = n==capacity?std::min(std::max(size_,capacity)*2,max_size):
+                                    std::clamp(average_*2,min_size,max_size);
+            }
+        private:
+            size_t average_ = 0,size_ = min_size;
+        };
+    }
+
     template<readahead_t ReadAhead,executor Executor,typename AsyncReadStream>
-        requires (ReadAhead==readahead_t::none)||
-                 readahead_available_stream<AsyncReadStream>
+        requires readahead_supported_stream<ReadAhead,AsyncReadStream>
     async_generator<cbuffer,Executor> async_stream_buffer_source(Executor /*ex*/,
             AsyncReadStream& stream,buffer_factory auto& bf)
     {
+        if constexpr(ReadAhead==readahead_t::adaptive){
+            // Read what is already there without waiting, and wait only when there is nothing.
+            // Parser hints still apply, as factories make buffers of at least the hinted size.
+            // The previous mode of the stream is restored when the source ends or is destroyed.
+            struct mode_restorer
+            {
+                AsyncReadStream& stream;
+                bool non_blocking = stream.non_blocking();
+
+                ~mode_restorer()
+                {
+                    boost::system::error_code ec;
+                    stream.non_blocking(non_blocking,ec);
+                }
+            } mr{stream};
+            stream.non_blocking(true);
+            detail::adaptive_readahead ra;
+            for(;;){
+                buffer buf = bf.get_buffer(ra.size());
+                boost::system::error_code ec;
+                size_t n;
+                while(!(n = stream.read_some(boost::asio::mutable_buffer(buf),ec))&&
+                        (ec==boost::asio::error::would_block||ec==boost::asio::error::try_again))
+                    co_await stream.async_wait(AsyncReadStream::wait_read,use_coroutine);
+                if(ec==boost::asio::error::eof)
+                    break;
+                if(ec)
+                    throw boost::system::system_error(ec);
+                ra.update(n,buf.size());
+                co_yield buffer(std::move(buf),0,n);
+            }
+            co_return;
+        }
         for(;;){
             buffer buf;
             if constexpr(ReadAhead==readahead_t::available){
@@ -55,9 +132,156 @@ namespace ampi
         }
     }
 
+    namespace detail
+    {
+        // Chain of reads of a stream, each started as soon as the previous one completes
+        // while there are less than depth buffers read and not consumed yet.
+        // Has to be used on the executor of the stream. Once cancelled, completion of
+        // the read in flight neither touches the factory nor starts another one.
+        template<typename AsyncReadStream,typename BufferFactory>
+        class read_pipeline : public std::enable_shared_from_this<read_pipeline<AsyncReadStream,
+                                                                                BufferFactory>>
+        {
+        public:
+            read_pipeline(AsyncReadStream& stream,BufferFactory& bf,size_t depth) noexcept
+                : stream_{stream},
+                  bf_{bf},
+                  depth_{depth}
+            {
+                assert(depth);
+            }
+
+            void fill()
+            {
+                if(cancelled_||reading_||ec_||ready_.size()>=depth_)
+                    return;
+                buffer buf = bf_.get_buffer();
+                auto mb = boost::asio::mutable_buffer(buf);
+                reading_ = true;
+                stream_.async_read_some(mb,[op=pending_read{this->shared_from_this()},
+                                            buf=std::move(buf)]
+                        (boost::system::error_code ec,size_t n) mutable {
+                    auto self = std::move(op.self);
+                    if(self->cancelled_)
+                        return;
+                    self->reading_ = false;
+                    if(n)
+                        self->ready_.emplace_back(std::move(buf),0,n);
+                    if(ec)
+                        self->ec_ = ec;
+                    else
+                        self->fill();
+                    self->waiter_.notify();
+                });
+            }
+
+            // Next read buffer, or nothing at the end of stream.
+            optional<cbuffer> pop()
+            {
+                if(ready_.empty()){
+                    if(ec_!=boost::asio::error::eof)
+                        throw boost::system::system_error(ec_);
+                    return {};
+                }
+                cbuffer buf = std::move(ready_.front());
+                ready_.pop_front();
+                return buf;
+            }
+
+            bool ready() const noexcept
+            {
+                return !ready_.empty()||ec_;
+            }
+
+            template<boost::asio::completion_token_for<void ()> CompletionToken>
+            auto async_wait(CompletionToken&& token)
+            {
+                assert(!ready()&&reading_);
+                return waiter_.async_wait(std::forward<CompletionToken>(token));
+            }
+
+            void cancel() noexcept
+            {
+                cancelled_ = true;
+                ready_.clear();
+                waiter_.cancel();
+            }
+        private:
+            // Cancels the pipeline if the read handler is destroyed without being called,
+            // e.g. on shutdown of its execution context. This destroys the waiting consumer
+            // instead of leaking it in a cycle with the pipeline.
+            struct pending_read
+            {
+                std::shared_ptr<read_pipeline> self;
+
+                pending_read(std::shared_ptr<read_pipeline> self) noexcept
+                    : self{std::move(self)}
+                {}
+
+                pending_read(pending_read&&) noexcept = default;
+
+                ~pending_read()
+                {
+                    if(self)
+                        self->cancel();
+                }
+            };
+
+            AsyncReadStream& stream_;
+            BufferFactory& bf_;
+            size_t depth_;
+            std::deque<cbuffer> ready_;
+            boost::system::error_code ec_;
+            bool reading_ = false,
+                 cancelled_ = false;
+            async_waiter waiter_;
+        };
+    }
+
+    // Keeps reading into up to depth buffers ahead of their consumer, so that reads
+    // overlap with parsing. Reads return whatever is available, parser hints only
+    // set the minimum size of buffers. Has to run on the executor of the stream.
+    // The factory is only used while the source lives. The stream has to outlive
+    // the read that may still be in flight when the source is destroyed, and data
+    // of that read and of buffers read ahead but not consumed yet is lost.
+    template<executor Executor,typename AsyncReadStream>
+    async_generator<cbuffer,Executor> pipelined_stream_buffer_source(Executor /*ex*/,
+            AsyncReadStream& stream,buffer_factory auto& bf,size_t depth = 2)
+    {
+        using read_pipeline = detail::read_pipeline<AsyncReadStream,
+                                                    std::remove_cvref_t<decltype(bf)>>;
+        struct canceller
+        {
+            std::shared_ptr<read_pipeline> rp;
+
+            ~canceller()
+            {
+                rp->cancel();
+            }
+        };
+        canceller c{std::make_shared<read_pipeline>(stream,bf,depth)};
+        auto& rp = c.rp;
+        for(;;){
+            rp->fill();
+            if(!rp->ready())
+                co_await rp->async_wait(use_coroutine);
+            optional<cbuffer> buf = rp->pop();
+            if(!buf)
+                break;
+            co_yield std::move(*buf);
+        }
+    }
+
+    template<typename AsyncReadStream>
+    auto pipelined_stream_buffer_source(AsyncReadStream& stream,buffer_factory auto& bf,
+                                        size_t depth = 2)
+        -> async_generator<cbuffer,decltype(stream.get_executor())>
+    {
+        return pipelined_stream_buffer_source(stream.get_executor(),stream,bf,depth);
+    }
+
     template<readahead_t ReadAhead,typename AsyncReadStream>
-        requires (ReadAhead==readahead_t::none)||
-                 readahead_available_stream<AsyncReadStream>
+        requires readahead_supported_stream<ReadAhead,AsyncReadStream>
     auto async_stream_buffer_source(AsyncReadStream& stream,buffer_factory auto& bf)
         -> async_generator<cbuffer,decltype(stream.get_executor())>
     {
@@ -0,0 +1,96 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_BBA17E2C_1E82_4B15_92E7_4E6C860BB166
+#define UUID_BBA17E2C_1E82_4B15_92E7_4E6C860BB166
+
+#include <ampi/buffer_sources/buffer_source.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <functional>
+
+namespace ampi
+{
+    // Keeps alive the buffers behind the views borrowing_buffer_source yields,
+    // until the caller releases those it no longer looks into.
+    class borrowed_buffers
+    {
+    public:
+        void keep(cbuffer buf)
+        {
+            if(buf.allocator())
+                bufs_.push_back(std::move(buf));
+        }
+
+        // Releases buffers kept before the one view points into. view must be
+        // a borrowed view or a slice of one whose buffer is still kept.
+        void release_before(const cbuffer& view) noexcept
+        {
+            std::less<const byte*> less;
+            auto it = std::ranges::find_if(bufs_,[&](const cbuffer& buf){
+                return !less(view.data(),buf.begin())&&!less(buf.end(),view.data());
+            });
+            assert(it!=bufs_.end()||!view.data());
+            if(it!=bufs_.end())
+                bufs_.erase(bufs_.begin(),it);
+        }
+
+        void release() noexcept
+        {
+            bufs_.clear();
+        }
+
+        bool empty() const noexcept
+        {
+            return bufs_.empty();
+        }
+    private:
+        std::deque<cbuffer> bufs_;
+    };
+
+    // Yields views of buffers from another source that don't own them, so copies and slices
+    // of what it yields are made without reference counting. kept owns the buffers instead,
+    // and views stay valid until the caller releases them there.
+    template<executor Executor,buffer_source BufferSource>
+    async_generator<cbuffer,Executor> borrowing_buffer_source(Executor /*ex*/,BufferSource& bs,
+                                                              borrowed_buffers& kept)
+    {
+        while(cbuffer* b = co_await bs){
+            cbuffer view = b->borrowed();
+            kept.keep(std::move(*b));
+            co_yield std::move(view);
+        }
+    }
+
+    // Keeps every buffer until this source is destroyed, so only suits bounded inputs
+    // like mapped files parsed into events or lazy documents.
+    template<executor Executor,buffer_source BufferSource>
+    async_generator<cbuffer,Executor> borrowing_buffer_source(Executor /*ex*/,BufferSource& bs)
+    {
+        borrowed_buffers kept;
+        while(cbuffer* b = co_await bs){
+            cbuffer view = b->borrowed();
+            kept.keep(std::move(*b));
+            co_yield std::move(view);
+        }
+    }
+
+    template<buffer_source BufferSource>
+    async_generator<cbuffer> borrowing_buffer_source(BufferSource& bs,borrowed_buffers& kept)
+    {
+        return borrowing_buffer_source(boost::asio::system_executor{},bs,kept);
+    }
+
+    template<buffer_source BufferSource>
+    async_generator<cbuffer> borrowing_buffer_source(BufferSource& bs)
+    {
+        return borrowing_buffer_source(boost::asio::system_executor{},bs);
+    }
+}
+
+#endif
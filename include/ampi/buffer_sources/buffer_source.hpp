@@ -18,7 +18,8 @@ namespace ampi
     enum struct readahead_t
     {
         none,
-        available
+        available,
+        adaptive
     };
 }
 
@@ -19,7 +19,7 @@ namespace ampi
     {
         while(stream){
             buffer buf = bf.get_buffer(size_t(
-                ReadAhead==readahead_t::available?
+                ReadAhead!=readahead_t::none?
                     std::max<std::streamsize>(0,stream.rdbuf()->in_avail()):0));
             if(!stream.read(reinterpret_cast<char*>(buf.data()),std::streamsize(buf.size()))||
                     !stream.gcount())
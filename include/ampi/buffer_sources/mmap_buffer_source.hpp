@@ -0,0 +1,79 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_D31B2120_7D11_4324_8BBA_6E64FBD856B2
+#define UUID_D31B2120_7D11_4324_8BBA_6E64FBD856B2
+
+#include <ampi/buffer_sources/buffer_source.hpp>
+#include <ampi/export.h>
+
+#include <filesystem>
+
+namespace ampi
+{
+    // Read-only file, pieces of which are mapped into buffers. Each mapping is released
+    // together with the last buffer referring to it, which may outlive the file object.
+    class AMPI_EXPORT mapped_file
+    {
+    public:
+        explicit mapped_file(const std::filesystem::path& path);
+
+        mapped_file(mapped_file&& other) noexcept
+            : fd_{std::exchange(other.fd_,-1)},
+              size_{std::exchange(other.size_,0)}
+        {}
+
+        mapped_file& operator=(mapped_file&& other) noexcept
+        {
+            std::swap(fd_,other.fd_);
+            std::swap(size_,other.size_);
+            return *this;
+        }
+
+        ~mapped_file();
+
+        size_t size() const noexcept
+        {
+            return size_;
+        }
+
+        static size_t page_size() noexcept;
+
+        // Offset must be a multiple of page_size(), n must be in 1..cbuffer::max_size.
+        cbuffer map(size_t offset,size_t n,bool sequential = true) const;
+    private:
+        int fd_;
+        size_t size_;
+    };
+
+    struct mmap_options
+    {
+        // Files are mapped by windows of this size rounded up to pages, or whole if it is 0,
+        // up to cbuffer::max_size.
+        size_t window_size = 0;
+        // Hints with MADV_SEQUENTIAL that pages are accessed in order.
+        bool sequential = true;
+    };
+
+    template<executor Executor>
+    generator<cbuffer,Executor> mmap_buffer_source(Executor /*ex*/,std::filesystem::path path,
+                                                   mmap_options options = {})
+    {
+        mapped_file file{path};
+        size_t ps = mapped_file::page_size(),
+               ws = std::min(options.window_size?(options.window_size+ps-1)/ps*ps:file.size(),
+                             cbuffer::max_size/ps*ps);
+        for(size_t offset=0;offset<file.size();offset+=ws)
+            co_yield file.map(offset,std::min(ws,file.size()-offset),options.sequential);
+    }
+
+    inline generator<cbuffer> mmap_buffer_source(std::filesystem::path path,mmap_options options = {})
+    {
+        return mmap_buffer_source(boost::asio::system_executor{},std::move(path),options);
+    }
+}
+
+#endif
@@ -14,7 +14,12 @@ namespace ampi
     template<executor Executor>
     noexcept_generator<cbuffer,Executor> one_buffer_source(Executor /*ex*/,binary_cview_t view)
     {
-        co_yield {view};
+        // Views larger than a cbuffer can hold are yielded in pieces.
+        do{
+            size_t n = std::min(view.size(),cbuffer::max_size);
+            co_yield {view.first(n)};
+            view = view.subspan(n);
+        }while(!view.empty());
     }
 
     inline noexcept_generator<cbuffer> one_buffer_source(binary_cview_t view)
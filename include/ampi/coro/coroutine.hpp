@@ -219,6 +219,16 @@ namespace ampi
         return detail::tail_yield_to_t<T>{std::move(subgen)};
     }
 
+    namespace detail
+    {
+        struct yield_nothing_t {};
+    }
+
+    // co_yield yield_nothing suspends a generator without a value: its awaiter gets nullptr
+    // as if the generator has finished, but it can still be resumed.
+    // Not supported with delegated yield, where nullptr results switch between subgenerators.
+    constexpr inline detail::yield_nothing_t yield_nothing;
+
     namespace detail
     {
         struct coroutine_promise_initial
@@ -353,6 +363,15 @@ namespace ampi
                     return stdcoro::suspend_always{};
             }
 
+            auto yield_value(detail::yield_nothing_t) noexcept
+            {
+                result_ = {};
+                if constexpr(bool(Options&coroutine_option::save_awaiter))
+                    return this->switch_to_awaiter_awaitable();
+                else
+                    return stdcoro::suspend_always{};
+            }
+
             Result* result() noexcept
             {
                 return result_;
@@ -421,6 +440,8 @@ namespace ampi
 
             using base_t::yield_value;
 
+            void yield_value(detail::yield_nothing_t) = delete;
+
             template<generator_yielding_exactly<Result> T>
             auto yield_value(T&& subgen) noexcept
                 requires (!std::is_reference_v<T>)
@@ -20,6 +20,14 @@
 #include <boost/preprocessor/tuple/elem.hpp>
 #include <boost/preprocessor/tuple/size.hpp>
 
+namespace ampi
+{
+    // Specialize as true_type for map keys without a matching member to be skipped
+    // instead of throwing structure_error::unknown_key, e.g. to accept newer producers.
+    template<typename T>
+    struct ignore_unknown_keys : std::false_type {};
+}
+
 namespace ampi::detail
 {
     template<typename Class,typename T,auto Getter,auto Setter>
@@ -11,6 +11,8 @@
 #include <ampi/event_sinks/event_sink.hpp>
 #include <ampi/filters/parser.hpp>
 
+#include <functional>
+
 namespace ampi
 {
     class msgunpack_ctx_base : public msgpack_ctx_base
@@ -34,8 +36,11 @@ namespace ampi
                 segmented_stack_resource ssr) noexcept
             : msgunpack_ctx_base{po,std::move(ssr)},
               bf_{std::move(spa)},
-              bs_{bsf(bf_)},
-              p_{bs_,bf_,po,ctx_.ex}
+              bsf_{std::move(bsf)},
+              bs_{bsf_(bf_)},
+              p_{bs_,bf_,po,ctx_.ex},
+              messages_{p_.consecutive()},
+              source_{p_,messages_}
         {}
 
         void set_initial(cbuffer buf) noexcept
@@ -49,8 +54,42 @@ namespace ampi
         }
     protected:
         pmr_buffer_factory bf_;
+        std::function<BufferSource (pmr_buffer_factory&)> bsf_;
         BufferSource bs_;
         parser<BufferSource,pmr_buffer_factory,pmr_system_executor> p_;
+        // Objects are read one after another from a single generator
+        // instead of starting a new one for each of them.
+        async_generator<event,pmr_system_executor> messages_;
+        parser_event_source<decltype(p_),decltype(messages_)> source_;
+
+        // Prepares source_ for the next object. A generator finished by the end of input
+        // or an error is started anew, along with the buffer source if that has ended,
+        // so that input arriving later is read. Returns whether the rest of an object
+        // abandoned by a sink that threw has to be dropped with skip_rest() first.
+        bool start_object()
+        {
+            if(!messages_){
+                if(!bs_)
+                    bs_ = bsf_(bf_);
+                messages_ = p_.consecutive();
+                source_.reset();
+            }
+            return source_.inside_object();
+        }
+
+        async_event_consumer skip_rest()
+        {
+            return [](pmr_system_executor,decltype(source_)& source) -> async_event_consumer {
+                while(source.inside_object())
+                    co_await source;
+            }(ctx_.ex,source_);
+        }
+
+        // Input after a parser error is not trusted to continue the object it was in.
+        void parser_failed() noexcept
+        {
+            messages_ = {};
+        }
     };
 }
 
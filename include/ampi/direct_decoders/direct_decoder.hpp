@@ -0,0 +1,372 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_A61F0C3E_52D8_4B97_8E2A_C4F7193D05B6
+#define UUID_A61F0C3E_52D8_4B97_8E2A_C4F7193D05B6
+
+#include <ampi/event_sinks/event_sink.hpp>
+#include <ampi/filters/span_parser.hpp>
+
+#include <utility>
+
+namespace ampi
+{
+    // Contiguous input of direct decoders, checked by the same rules as span_parser.
+    class direct_reader
+    {
+    public:
+        explicit direct_reader(binary_cview_t data,parser_options options = {}) noexcept
+            : data_{data},
+              options_{options}
+        {}
+
+        detail::decoded_header header()
+        {
+            const byte* p = data_.data()+pos_;
+            size_t avail = data_.size()-pos_,
+                   n = avail?detail::header_size(p,avail):1;
+            if(n>avail)
+                throw parser_error{parser_error::reason_t::unexpected_end};
+            pos_ += n;
+            return detail::decode_header(p);
+        }
+
+        // Consumes a nil if it is next.
+        bool nil() noexcept
+        {
+            if(pos_==data_.size()||data_[pos_]!=byte{0xc0})
+                return false;
+            ++pos_;
+            return true;
+        }
+
+        // Consumes a boolean or number if it is next and fits into x exactly, loading it
+        // straight from the input. Anything else is left for header() to decode and report.
+        template<typename T>
+            requires std::is_same_v<T,bool>||arithmetic<T>
+        bool scalar(T& x) noexcept
+        {
+            if(pos_==data_.size())
+                return false;
+            const byte* p = data_.data()+pos_;
+            auto first_byte = uint8_t(*p);
+            size_t n = detail::leading_byte_sizes[first_byte];
+            if(data_.size()-pos_<n)
+                return false;
+            if constexpr(std::is_same_v<T,bool>){
+                if((first_byte|1)!=0xc3)
+                    return false;
+                x = first_byte&1;
+            }else if constexpr(std::is_same_v<T,float>){
+                if(first_byte!=0xca)
+                    return false;
+                x = detail::load_big_endian<float>(p+1);
+            }else if constexpr(std::is_same_v<T,double>){
+                if(first_byte!=0xcb)
+                    return false;
+                x = detail::load_big_endian<double>(p+1);
+            }else{
+                auto fits = [&](auto v){
+                    if(!std::in_range<T>(v))
+                        return false;
+                    x = T(v);
+                    return true;
+                };
+                bool ok;
+                if(first_byte<0x80)
+                    ok = fits(first_byte);
+                else if(first_byte>=0xe0)
+                    ok = fits(int8_t(first_byte));
+                else
+                    switch(first_byte){
+                        case 0xcc:
+                            ok = fits(detail::load_big_endian<uint8_t>(p+1));
+                            break;
+                        case 0xcd:
+                            ok = fits(detail::load_big_endian<uint16_t>(p+1));
+                            break;
+                        case 0xce:
+                            ok = fits(detail::load_big_endian<uint32_t>(p+1));
+                            break;
+                        case 0xcf:
+                            ok = fits(detail::load_big_endian<uint64_t>(p+1));
+                            break;
+                        case 0xd0:
+                            ok = fits(detail::load_big_endian<int8_t>(p+1));
+                            break;
+                        case 0xd1:
+                            ok = fits(detail::load_big_endian<int16_t>(p+1));
+                            break;
+                        case 0xd2:
+                            ok = fits(detail::load_big_endian<int32_t>(p+1));
+                            break;
+                        case 0xd3:
+                            ok = fits(detail::load_big_endian<int64_t>(p+1));
+                            break;
+                        default:
+                            ok = false;
+                    }
+                if(!ok)
+                    return false;
+            }
+            pos_ += n;
+            return true;
+        }
+
+        // Data of n bytes following a string, binary or extension header.
+        binary_cview_t bytes(size_t n)
+        {
+            if(data_.size()-pos_<n)
+                throw parser_error{parser_error::reason_t::unexpected_end};
+            return data_.subspan(std::exchange(pos_,pos_+n),n);
+        }
+
+        string_view chars(size_t n)
+        {
+            binary_cview_t d = bytes(n);
+            string_view s{reinterpret_cast<const char*>(d.data()),d.size()};
+            if(!(options_&parser_option::skip_utf8_validation)&&utf8_validator::validate(s))
+                throw parser_error{parser_error::reason_t::invalid_utf8};
+            return s;
+        }
+
+        // Encoding of the complete next value, which is stepped over.
+        binary_cview_t value()
+        {
+            return bytes(detail::encoded_value_size(data_.subspan(pos_)));
+        }
+
+        void skip_value()
+        {
+            value();
+        }
+
+        parser_options options() const noexcept
+        {
+            return options_;
+        }
+
+        size_t position() const noexcept
+        {
+            return pos_;
+        }
+    private:
+        binary_cview_t data_;
+        size_t pos_ = 0;
+        parser_options options_;
+    };
+
+    // Direct decoders fill objects from a direct_reader with plain nested calls,
+    // without coroutines or events. A direct decoder factory returns a callable
+    // taking (direct_reader&,T&). Values of types that have no direct decoder
+    // are passed to their event sinks through a span_parser over their encoding.
+    // msgunpack picks the path by whether a direct decoder is declared, so headers
+    // declaring event sinks for a family of types include its direct decoders as well,
+    // to make that choice the same in every translation unit, as ODR requires.
+    namespace direct_decoder_ns
+    {
+        namespace detail
+        {
+            template<typename T,typename U>
+            concept direct_decoder_factory = requires(T ddf,direct_reader& r,U& x){
+                ddf(r,x);
+            };
+        }
+
+        constexpr inline struct direct_decoder_fn
+        {
+            template<typename T>
+                requires detail::direct_decoder_factory<
+                    tag_invoke_result_t<direct_decoder_fn,type_tag_t<T>>,
+                    T
+                >
+            auto operator()(type_tag_t<T> tt) const noexcept
+            {
+                return ampi::tag_invoke(*this,tt);
+            }
+        } direct_decoder;
+    }
+
+    using direct_decoder_ns::direct_decoder;
+
+    template<typename T>
+    concept direct_decodable = is_tag_invocable_v<tag_t<direct_decoder>,type_tag_t<T>>;
+
+    namespace direct_decoder_ns
+    {
+        namespace detail
+        {
+            template<typename T>
+            ampi::detail::decoded_header expect_header(direct_reader& r,object_kind_set expected)
+            {
+                auto h = r.header();
+                if(!(h.e.kind()&expected))
+                    throw structure_error{structure_error::reason_t::unexpected_event,
+                                          boost::typeindex::type_id<T>(),expected,std::move(h.e)};
+                return h;
+            }
+
+            template<typename T>
+            void check_sequence_size(ampi::detail::decoded_header& h,size_t n)
+            {
+                if(h.e.template get_if<sequence_header>()->size!=n)
+                    throw structure_error{structure_error::reason_t::out_of_range,
+                                          boost::typeindex::type_id<T>(),
+                                          {object_kind::sequence},std::move(h.e)};
+            }
+        }
+
+        template<deserializable T>
+        void decode_value(direct_reader& r,T& x)
+        {
+            if constexpr(direct_decodable<T>)
+                direct_decoder(type_tag<T>)(r,x);
+            else{
+                span_parser sp{r.value(),r.options()};
+                ampi::detail::stack_executor_ctx ctx;
+                auto sink = serial_event_sink(type_tag<T>)(ctx.ex,sp,x).assume_blocking();
+                sink();
+            }
+        }
+
+        template<serial_event_sink_ns::scalar_deserializable T>
+        auto tag_invoke(tag_t<direct_decoder>,type_tag_t<T>) noexcept
+        {
+            return [](direct_reader& r,T& x){
+                if constexpr(std::is_same_v<T,std::nullptr_t>){
+                    if(r.nil())
+                        return;
+                }else if constexpr(!std::is_same_v<T,timestamp_t>)
+                    if(r.scalar(x))
+                        return;
+                // Slow path, also reporting mismatches.
+                auto h = r.header();
+                serial_event_sink_ns::assign_scalar(&h.e,x);
+            };
+        }
+
+        template<typename Allocator>
+        inline auto tag_invoke(tag_t<direct_decoder>,
+                               type_tag_t<std::basic_string<char,std::char_traits<char>,Allocator>>) noexcept
+        {
+            return [](direct_reader& r,auto& x){
+                auto h = detail::expect_header<decltype(x)>(r,{object_kind::string});
+                string_view s = r.chars(h.data_length);
+                x.assign(s.data(),s.size());
+            };
+        }
+
+        template<typename Allocator>
+        inline auto tag_invoke(tag_t<direct_decoder>,
+                               type_tag_t<boost::container::vector<byte,Allocator>>) noexcept
+        {
+            return [](direct_reader& r,auto& x){
+                auto h = detail::expect_header<decltype(x)>(r,{object_kind::binary});
+                binary_cview_t d = r.bytes(h.data_length);
+                x.assign(d.begin(),d.end());
+            };
+        }
+
+        template<deserializable T>
+            requires regular_optional_state<T>
+        auto tag_invoke(tag_t<direct_decoder>,type_tag_t<optional<T>>) noexcept
+        {
+            return [](direct_reader& r,optional<T>& x){
+                if(r.nil())
+                    x.reset();
+                else{
+                    if(!x)
+                        x.emplace();
+                    decode_value(r,*x);
+                }
+            };
+        }
+
+        template<serial_event_sink_ns::deserializable_tuple_like T>
+        auto tag_invoke(tag_t<direct_decoder>,type_tag_t<T>) noexcept
+        {
+            constexpr auto n = std::tuple_size_v<T>;
+            return []<size_t... Indices>(std::index_sequence<Indices...>){
+                return [](direct_reader& r,T& x){
+                    auto h = detail::expect_header<T>(r,{object_kind::sequence});
+                    detail::check_sequence_size<T>(h,n);
+                    (...,decode_value(r,get<Indices>(x)));
+                };
+            }(std::make_index_sequence<n>{});
+        }
+
+        template<container_like T>
+            requires (!map_like<T>)&&(
+                         serial_event_sink_ns::overwritable_container_like<T>||
+                         serial_event_sink_ns::resizeable_container_like<T>||
+                         serial_event_sink_ns::emplace_back_container_like<T>||
+                         serial_event_sink_ns::set_container_like<T>)&&
+                     deserializable<container_value_type_t<T>>
+        auto tag_invoke(tag_t<direct_decoder>,type_tag_t<T>) noexcept
+        {
+            return [](direct_reader& r,T& x){
+                auto h = detail::expect_header<T>(r,{object_kind::sequence});
+                uint32_t s = h.e.template get_if<sequence_header>()->size;
+                using size_type = decltype(std::size(x));
+                auto throw_out_of_range = [&]{
+                    throw structure_error{structure_error::reason_t::out_of_range,
+                                          boost::typeindex::type_id<T>(),
+                                          {object_kind::unsigned_int},std::move(h.e)};
+                };
+                if(std::cmp_greater(s,std::numeric_limits<size_type>::max()))
+                    throw_out_of_range();
+                auto n = size_type(s);
+                using namespace serial_event_sink_ns;
+                if constexpr(resizeable_container_like<T>||
+                        (!emplace_back_container_like<T>&&!set_container_like<T>)){
+                    if constexpr(resizeable_container_like<T>)
+                        x.resize(n);
+                    else if(n!=std::size(x))
+                        throw_out_of_range();
+                    for(auto& e:x)
+                        decode_value(r,e);
+                }else{
+                    x.clear();
+                    for(size_type i=0;i<n;++i)
+                        if constexpr(emplace_back_container_like<T>)
+                            decode_value(r,x.emplace_back());
+                        else{
+                            typename T::value_type v;
+                            decode_value(r,v);
+                            check_unique_key<T>(x.emplace(std::move(v)));
+                        }
+                }
+            };
+        }
+
+        template<map_like T>
+            requires deserializable<std::remove_const_t<map_like_key_type<T>>>&&
+                    deserializable<map_like_mapped_type<T>>
+        auto tag_invoke(tag_t<direct_decoder>,type_tag_t<T>) noexcept
+        {
+            return [](direct_reader& r,T& x){
+                auto h = detail::expect_header<T>(r,{object_kind::map});
+                uint32_t s = h.e.template get_if<map_header>()->size;
+                using size_type = decltype(std::size(x));
+                if(std::cmp_greater(s,std::numeric_limits<size_type>::max()))
+                    throw structure_error{structure_error::reason_t::out_of_range,
+                                          boost::typeindex::type_id<T>(),
+                                          {object_kind::unsigned_int},std::move(h.e)};
+                auto n = size_type(s);
+                x.clear();
+                for(size_type i=0;i<n;++i){
+                    std::remove_const_t<map_like_key_type<T>> k;
+                    decode_value(r,k);
+                    map_like_mapped_type<T> v;
+                    decode_value(r,v);
+                    serial_event_sink_ns::check_unique_key<T>(x.emplace(std::move(k),std::move(v)));
+                }
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,156 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_0D93B7E4_F1A2_4C68_9B05_7E3A6C28D41F
+#define UUID_0D93B7E4_F1A2_4C68_9B05_7E3A6C28D41F
+
+#include <ampi/detail/hana_struct.hpp>
+#include <ampi/direct_decoders/direct_decoder.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <bitset>
+
+namespace ampi::direct_decoder_ns
+{
+    namespace detail
+    {
+        template<typename T>
+            requires boost::hana::Struct<T>::value
+        constexpr bool direct_decodable_hana_struct() noexcept
+        {
+            auto a = boost::hana::accessors<T>();
+            constexpr size_t n = boost::hana::size(a);
+            if(n>0xffffffff)
+                return false;
+            return []<size_t... Indices>(std::index_sequence<Indices...>){
+                return (...&&[]<typename A>(type_tag_t<A>){
+                    using result_t = ampi::detail::accessor_result_t<A>;
+                    return deserializable<result_t>&&std::is_assignable_v<A,result_t>;
+                }(type_tag<decltype(boost::hana::second(a[boost::hana::size_c<Indices>])
+                                    (std::declval<T&>()))>));
+            }(std::make_index_sequence<n>{});
+        }
+
+        // Hash table of N names built at compile time, with the seed picked
+        // to spread them as evenly as possible, usually one per bucket.
+        template<size_t N>
+        struct name_table
+        {
+            constexpr static size_t buckets = std::bit_ceil(N*2);
+
+            std::array<string_view,N> names;
+            uint32_t seed = 0;
+            // Indices of names in bucket b are order[starts[b]..starts[b+1]).
+            std::array<size_t,buckets+1> starts = {};
+            std::array<size_t,N> order = {};
+
+            constexpr static size_t bucket(string_view key,uint32_t seed) noexcept
+            {
+                uint32_t h = 2166136261u^seed;
+                for(char c:key){
+                    h ^= uint8_t(c);
+                    h *= 16777619u;
+                }
+                return h&(buckets-1);
+            }
+
+            constexpr explicit name_table(std::array<string_view,N> ns) noexcept
+                : names{ns}
+            {
+                size_t best = N+1;
+                for(uint32_t s=0;s<64&&best>1;++s){
+                    std::array<size_t,buckets> counts = {};
+                    size_t m = 0;
+                    for(auto name:names)
+                        m = std::max(m,++counts[bucket(name,s)]);
+                    if(m<best){
+                        best = m;
+                        seed = s;
+                    }
+                }
+                std::array<size_t,buckets> counts = {};
+                for(auto name:names)
+                    ++counts[bucket(name,seed)];
+                for(size_t b=0;b<buckets;++b)
+                    starts[b+1] = starts[b]+counts[b];
+                for(size_t i=0;i<N;++i){
+                    size_t b = bucket(names[i],seed);
+                    order[starts[b+1]-counts[b]--] = i;
+                }
+            }
+
+            // Index of key in names, N if it is not there.
+            constexpr size_t find(string_view key) const noexcept
+            {
+                size_t b = bucket(key,seed);
+                for(size_t j=starts[b];j<starts[b+1];++j)
+                    if(names[order[j]]==key)
+                        return order[j];
+                return N;
+            }
+        };
+
+        template<typename T>
+        constexpr inline auto member_names = []<size_t... Indices>(std::index_sequence<Indices...>){
+            return name_table<sizeof...(Indices)>{{string_view{std::remove_cvref_t<
+                decltype(boost::hana::first(boost::hana::accessors<T>()[boost::hana::size_c<Indices>]))
+            >::c_str()}...}};
+        }(std::make_index_sequence<boost::hana::size(boost::hana::accessors<T>())>{});
+    }
+
+    template<typename T>
+    concept direct_decodable_hana_struct = detail::direct_decodable_hana_struct<T>();
+
+    // Keys are matched without copying them through a hash table of member names
+    // built at compile time, so each key is compared with one name in most cases.
+    template<direct_decodable_hana_struct T>
+    auto tag_invoke(tag_t<direct_decoder>,type_tag_t<T>) noexcept
+    {
+        return []<size_t... Indices>(std::index_sequence<Indices...>){
+            return [](direct_reader& r,T& x){
+                auto a = boost::hana::accessors<T>();
+                auto h = detail::expect_header<T>(r,{object_kind::map});
+                uint32_t n = h.e.template get_if<map_header>()->size;
+                constexpr size_t s = sizeof...(Indices);
+                if(!ignore_unknown_keys<T>::value&&n>s)
+                    throw structure_error{structure_error::reason_t::out_of_range,
+                                          boost::typeindex::type_id<T>(),
+                                          {object_kind::sequence},std::move(h.e)};
+                std::bitset<s> seen;
+                auto decode_member = [&](auto i){
+                    if(seen[i])
+                        throw structure_error{structure_error::reason_t::duplicate_key,
+                                              boost::typeindex::type_id<T>()};
+                    seen[i] = true;
+                    decltype(auto) v = boost::hana::second(a[i])(x);
+                    using result_t = ampi::detail::accessor_result_t<decltype(v)>;
+                    if constexpr(std::is_same_v<std::remove_cvref_t<decltype(v)>,result_t>)
+                        decode_value(r,v);
+                    else{
+                        result_t y;
+                        decode_value(r,y);
+                        v = std::move(y);
+                    }
+                };
+                for(uint32_t i=0;i<n;++i){
+                    auto kh = detail::expect_header<T>(r,{object_kind::string});
+                    size_t m = detail::member_names<T>.find(r.chars(kh.data_length));
+                    if(!(...||(m==Indices&&(decode_member(boost::hana::size_c<Indices>),true)))){
+                        if constexpr(!ignore_unknown_keys<T>::value)
+                            throw structure_error{structure_error::reason_t::unknown_key,
+                                                  boost::typeindex::type_id<T>(),{},std::move(h.e)};
+                        else
+                            r.skip_value();
+                    }
+                }
+            };
+        }(std::make_index_sequence<boost::hana::size(boost::hana::accessors<T>())>{});
+    }
+}
+
+#endif
@@ -0,0 +1,46 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_58C2E6A7_3D91_4F0B_A4E8_B19F07D5C362
+#define UUID_58C2E6A7_3D91_4F0B_A4E8_B19F07D5C362
+
+#include <ampi/detail/pfr_tuple.hpp>
+#include <ampi/direct_decoders/direct_decoder.hpp>
+
+namespace ampi::direct_decoder_ns
+{
+    namespace detail
+    {
+        template<ampi::detail::pfr_tuple T>
+        constexpr bool direct_decodable_pfr_tuple() noexcept
+        {
+            constexpr auto n = boost::pfr::tuple_size_v<T>;
+            if(n>0xffffffff)
+                return false;
+            return []<size_t... Indices>(std::index_sequence<Indices...>){
+                return (...&&deserializable<boost::pfr::tuple_element_t<Indices,T>>);
+            }(std::make_index_sequence<n>{});
+        }
+    }
+
+    template<typename T>
+    concept direct_decodable_pfr_tuple = detail::direct_decodable_pfr_tuple<T>();
+
+    template<direct_decodable_pfr_tuple T>
+    auto tag_invoke(tag_t<direct_decoder>,type_tag_t<T>) noexcept
+    {
+        constexpr auto n = boost::pfr::tuple_size_v<T>;
+        return []<size_t... Indices>(std::index_sequence<Indices...>){
+            return [](direct_reader& r,T& x){
+                auto h = detail::expect_header<T>(r,{object_kind::sequence});
+                detail::check_sequence_size<T>(h,n);
+                (...,decode_value(r,boost::pfr::get<Indices>(x)));
+            };
+        }(std::make_index_sequence<n>{});
+    }
+}
+
+#endif
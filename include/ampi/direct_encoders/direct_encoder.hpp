@@ -0,0 +1,190 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_4B7E2D90_1C3A_4F6E_9D58_A0E7C2B461F3
+#define UUID_4B7E2D90_1C3A_4F6E_9D58_A0E7C2B461F3
+
+#include <ampi/event_sources/event_source.hpp>
+#include <ampi/filters/emitter.hpp>
+
+namespace ampi
+{
+    // Direct encoders write the same bytes as serial_event_source followed by emitter,
+    // but as plain nested calls without coroutines and events. A direct encoder factory
+    // returns a callable taking (const T&,alloc) that puts the encoding of the object
+    // into space for n bytes returned by successive calls to alloc(n).
+    namespace direct_encoder_ns
+    {
+        namespace detail
+        {
+            using alloc_archetype = byte* (*)(size_t);
+
+            template<typename T,typename U>
+            concept direct_encoder_factory = requires(T def,const U& x,alloc_archetype alloc){
+                def(x,alloc);
+            };
+        }
+
+        constexpr inline struct direct_encoder_fn
+        {
+            template<typename T>
+                requires detail::direct_encoder_factory<
+                    tag_invoke_result_t<direct_encoder_fn,type_tag_t<T>>,
+                    T
+                >
+            auto operator()(type_tag_t<T> tt) const noexcept
+            {
+                return ampi::tag_invoke(*this,tt);
+            }
+        } direct_encoder;
+    }
+
+    using direct_encoder_ns::direct_encoder;
+
+    template<typename T>
+    concept direct_encodable = is_tag_invocable_v<tag_t<direct_encoder>,type_tag_t<T>>;
+
+    namespace direct_encoder_ns
+    {
+        namespace detail
+        {
+            template<serial_event_source_ns::serializable_tuple_like T>
+            constexpr bool direct_encodable_tuple() noexcept
+            {
+                return []<size_t... Indices>(std::index_sequence<Indices...>){
+                    return (...&&direct_encodable<std::tuple_element_t<Indices,T>>);
+                }(std::make_index_sequence<std::tuple_size_v<T>>{});
+            }
+        }
+
+        template<typename T>
+        concept direct_encodable_tuple_like = detail::direct_encodable_tuple<T>();
+
+        template<typename T>
+            requires std::is_same_v<T,std::nullptr_t>||
+                    std::is_same_v<T,bool>||
+                    std::is_same_v<T,float>||
+                    std::is_same_v<T,double>||
+                    std::is_same_v<T,timestamp_t>
+        auto tag_invoke(tag_t<direct_encoder>,type_tag_t<T>) noexcept
+        {
+            return [](T x,auto&& alloc){
+                if constexpr(std::is_same_v<T,std::nullptr_t>)
+                    ampi::detail::encode_null(alloc);
+                else if constexpr(std::is_same_v<T,bool>)
+                    ampi::detail::encode_bool(x,alloc);
+                else if constexpr(std::is_same_v<T,float>)
+                    ampi::detail::encode_float(x,alloc);
+                else if constexpr(std::is_same_v<T,double>)
+                    ampi::detail::encode_double(x,alloc);
+                else
+                    ampi::detail::encode_timestamp(x,alloc);
+            };
+        }
+
+        template<integral T>
+        auto tag_invoke(tag_t<direct_encoder>,type_tag_t<T>) noexcept
+        {
+            return [](T x,auto&& alloc){
+                if constexpr(std::is_signed_v<T>)
+                    ampi::detail::encode_signed(x,alloc);
+                else
+                    ampi::detail::encode_unsigned(x,alloc);
+            };
+        }
+
+        template<std::convertible_to<string_view> T>
+            requires (!std::is_same_v<T,std::nullptr_t>)
+        auto tag_invoke(tag_t<direct_encoder>,type_tag_t<T>) noexcept
+        {
+            return [](string_view x,auto&& alloc){
+                ampi::detail::encode_string_header(serial_event_source_ns::check_size<T>(x.size()),alloc);
+                ampi::detail::encode_data(x.data(),x.size(),alloc);
+            };
+        }
+
+        template<std::convertible_to<binary_cview_t> T>
+        auto tag_invoke(tag_t<direct_encoder>,type_tag_t<T>) noexcept
+        {
+            return [](binary_cview_t x,auto&& alloc){
+                ampi::detail::encode_binary_header(serial_event_source_ns::check_size<T>(x.size()),alloc);
+                ampi::detail::encode_data(x.data(),x.size(),alloc);
+            };
+        }
+
+        template<direct_encodable T>
+            requires regular_optional_state<T>
+        auto tag_invoke(tag_t<direct_encoder>,type_tag_t<optional<T>>) noexcept
+        {
+            return [](const optional<T>& x,auto&& alloc){
+                if(x)
+                    direct_encoder(type_tag<T>)(*x,alloc);
+                else
+                    ampi::detail::encode_null(alloc);
+            };
+        }
+
+        template<direct_encodable... Ts>
+        auto tag_invoke(tag_t<direct_encoder>,type_tag_t<variant<Ts...>>) noexcept
+        {
+            return []<size_t... Indices>(std::index_sequence<Indices...>){
+                return [](const variant<Ts...>& x,auto&& alloc){
+                    ampi::detail::encode_container_header(false,2,alloc);
+                    auto i = x.index();
+                    ampi::detail::encode_unsigned(i,alloc);
+                    static_cast<void>((...||(i==Indices&&(
+                        direct_encoder(type_tag<Ts>)(*get_if<Indices>(&x),alloc),true))));
+                };
+            }(std::index_sequence_for<Ts...>{});
+        }
+
+        template<direct_encodable_tuple_like T>
+        auto tag_invoke(tag_t<direct_encoder>,type_tag_t<T>) noexcept
+        {
+            return []<size_t... Indices>(std::index_sequence<Indices...>){
+                return [](const T& x,auto&& alloc){
+                    ampi::detail::encode_container_header(false,uint32_t(std::tuple_size_v<T>),alloc);
+                    (...,direct_encoder(type_tag<std::tuple_element_t<Indices,T>>)(get<Indices>(x),alloc));
+                };
+            }(std::make_index_sequence<std::tuple_size_v<T>>{});
+        }
+
+        template<container_like T>
+            requires (!std::convertible_to<T,string_view>)&&
+                     (!std::convertible_to<T,binary_cview_t>)&&
+                     (!map_like<T>)&&
+                     direct_encodable<container_value_type_t<T>>
+        auto tag_invoke(tag_t<direct_encoder>,type_tag_t<T>) noexcept
+        {
+            return [](const T& x,auto&& alloc){
+                ampi::detail::encode_container_header(
+                    false,serial_event_source_ns::check_size<T>(std::size(x)),alloc);
+                auto de = direct_encoder(type_tag<container_value_type_t<T>>);
+                for(auto& e:x)
+                    de(e,alloc);
+            };
+        }
+
+        template<map_like T>
+            requires direct_encodable<std::remove_const_t<map_like_key_type<T>>>&&
+                    direct_encodable<map_like_mapped_type<T>>
+        auto tag_invoke(tag_t<direct_encoder>,type_tag_t<T>) noexcept
+        {
+            return [](const T& x,auto&& alloc){
+                ampi::detail::encode_container_header(
+                    true,serial_event_source_ns::check_size<T>(std::size(x)),alloc);
+                auto dek = direct_encoder(type_tag<std::remove_const_t<map_like_key_type<T>>>);
+                auto dev = direct_encoder(type_tag<map_like_mapped_type<T>>);
+                for(auto& [k,v]:x){
+                    dek(k,alloc);
+                    dev(v,alloc);
+                }
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,85 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_E2A9C4F1_6B0D_4E83_A57C_19D3F8B20E6A
+#define UUID_E2A9C4F1_6B0D_4E83_A57C_19D3F8B20E6A
+
+#include <ampi/detail/hana_struct.hpp>
+#include <ampi/direct_encoders/direct_encoder.hpp>
+
+#include <array>
+
+namespace ampi
+{
+    namespace detail
+    {
+        template<char... Chars>
+        constexpr auto encoded_string(boost::hana::string<Chars...>) noexcept
+        {
+            constexpr size_t n = sizeof...(Chars);
+            static_assert(n<=0xffff);
+            if constexpr(n<=0x1f)
+                return std::array<byte,1+n>{byte{uint8_t(0xa0+n)},byte(Chars)...};
+            else if constexpr(n<=0xff)
+                return std::array<byte,1+1+n>{byte{0xd9},byte{uint8_t(n)},byte(Chars)...};
+            else
+                return std::array<byte,1+2+n>{byte{0xda},byte{uint8_t(n>>8)},byte{uint8_t(n)},
+                                              byte(Chars)...};
+        }
+
+        // MessagePack string for a compile-time hana::string type.
+        template<typename String>
+        constexpr inline auto encoded_string_v = encoded_string(String{});
+    }
+
+    namespace direct_encoder_ns
+    {
+        namespace detail
+        {
+            template<typename T>
+                requires boost::hana::Struct<T>::value
+            constexpr bool direct_encodable_hana_struct() noexcept
+            {
+                auto a = boost::hana::accessors<T>();
+                constexpr size_t n = boost::hana::size(a);
+                if(n>0xffffffff)
+                    return false;
+                return []<size_t... Indices>(std::index_sequence<Indices...>){
+                    return (...&&direct_encodable<ampi::detail::accessor_result_t<
+                        decltype(boost::hana::second(a[boost::hana::size_c<Indices>])
+                        (std::declval<T>()))>>);
+                }(std::make_index_sequence<n>{});
+            }
+        }
+
+        template<typename T>
+        concept direct_encodable_hana_struct = detail::direct_encodable_hana_struct<T>();
+
+        // Keys are written from constant byte arrays, including their string headers.
+        template<direct_encodable_hana_struct T>
+        auto tag_invoke(tag_t<direct_encoder>,type_tag_t<T>) noexcept
+        {
+            return []<size_t... Indices>(std::index_sequence<Indices...>){
+                return [](const T& x,auto&& alloc){
+                    auto a = boost::hana::accessors<T>();
+                    ampi::detail::encode_container_header(true,uint32_t(sizeof...(Indices)),alloc);
+                    auto put_key = [&](auto i){
+                        auto& key = ampi::detail::encoded_string_v<
+                            std::remove_cvref_t<decltype(boost::hana::first(a[i]))>>;
+                        ampi::detail::encode_data(key.data(),key.size(),alloc);
+                    };
+                    auto put_value = [&](auto i){
+                        decltype(auto) v = boost::hana::second(a[i])(x);
+                        direct_encoder(type_tag<ampi::detail::accessor_result_t<decltype(v)>>)(v,alloc);
+                    };
+                    (...,(put_key(boost::hana::size_c<Indices>),put_value(boost::hana::size_c<Indices>)));
+                };
+            }(std::make_index_sequence<boost::hana::size(boost::hana::accessors<T>())>{});
+        }
+    }
+}
+
+#endif
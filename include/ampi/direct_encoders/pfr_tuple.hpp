@@ -0,0 +1,45 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_7F05B3D2_A84C_4196_BE3E_6C2D0A95F718
+#define UUID_7F05B3D2_A84C_4196_BE3E_6C2D0A95F718
+
+#include <ampi/detail/pfr_tuple.hpp>
+#include <ampi/direct_encoders/direct_encoder.hpp>
+
+namespace ampi::direct_encoder_ns
+{
+    namespace detail
+    {
+        template<ampi::detail::pfr_tuple T>
+        constexpr bool direct_encodable_pfr_tuple() noexcept
+        {
+            constexpr auto n = boost::pfr::tuple_size_v<T>;
+            if(n>0xffffffff)
+                return false;
+            return []<size_t... Indices>(std::index_sequence<Indices...>){
+                return (...&&direct_encodable<boost::pfr::tuple_element_t<Indices,T>>);
+            }(std::make_index_sequence<n>{});
+        }
+    }
+
+    template<typename T>
+    concept direct_encodable_pfr_tuple = detail::direct_encodable_pfr_tuple<T>();
+
+    template<direct_encodable_pfr_tuple T>
+    auto tag_invoke(tag_t<direct_encoder>,type_tag_t<T>) noexcept
+    {
+        return []<size_t... Indices>(std::index_sequence<Indices...>){
+            return [](const T& x,auto&& alloc){
+                ampi::detail::encode_container_header(false,uint32_t(boost::pfr::tuple_size_v<T>),alloc);
+                (...,direct_encoder(type_tag<boost::pfr::tuple_element_t<Indices,T>>)
+                    (boost::pfr::get<Indices>(x),alloc));
+            };
+        }(std::make_index_sequence<boost::pfr::tuple_size_v<T>>{});
+    }
+}
+
+#endif
@@ -304,6 +304,10 @@ namespace ampi
         constexpr static bool is_event_type_v = boost::mp11::mp_find<decltype(v_),T>{}<
                                                 boost::mp11::mp_size<decltype(v_)>{};
     public:
+        event() noexcept
+            : v_{nullptr}
+        {}
+
         event(std::convertible_to<decltype(v_)> auto x)
             : v_{std::move(x)}
         {}
@@ -346,8 +350,16 @@ namespace ampi
         friend AMPI_EXPORT std::ostream& operator<<(std::ostream& stream,const event& e);
     };
 
+    // Besides event generators, any awaitable producing event* can be a source,
+    // which allows non-coroutine parsers and batching adapters to feed sinks directly.
+    template<typename T>
+    concept event_source = async_generator_yielding<T,event>||
+        requires(T& es) {
+            { get_awaiter(es).await_resume() } -> std::same_as<event*>;
+        };
+
     template<typename T>
-    concept event_source = async_generator_yielding<T,event>;
+    concept event_visitor = std::invocable<T&,event>;
 
     constexpr inline size_t max_msgpack_fixed_buffer_length = 1+1+1+4+8; // timestamp 96
 }
@@ -7,6 +7,7 @@
 #ifndef UUID_AE8C6F44_6A99_451C_B58F_487698EA0A60
 #define UUID_AE8C6F44_6A99_451C_B58F_487698EA0A60
 
+#include <ampi/coro/awaiter_wrapper.hpp>
 #include <ampi/event_endpoints.hpp>
 
 #include <limits>
@@ -132,66 +133,118 @@ namespace ampi
             }
         }
 
-        inline auto tag_invoke(tag_t<serial_event_sink>,type_tag_t<std::nullptr_t>) noexcept
+        async_event_consumer skip_events(pmr_system_executor,event_source auto& source)
         {
-            return [](pmr_system_executor,event_source auto& source,std::nullptr_t& /*x*/)
-                    -> async_event_consumer {
-                expect_event<std::nullptr_t>(co_await source,{object_kind::null});
-            };
+            uint32_t data_length = 0;
+            for(uint64_t remaining_items=1;remaining_items;){
+                event e = expect_event<event>(co_await source);
+                switch(e.kind()){
+                    case object_kind::map:
+                        remaining_items += e.get_if<map_header>()->size*2ull;
+                        break;
+                    case object_kind::sequence:
+                        remaining_items += e.get_if<sequence_header>()->size;
+                        break;
+                    case object_kind::binary:
+                        data_length = e.get_if<binary_header>()->size;
+                        break;
+                    case object_kind::extension:
+                        data_length = e.get_if<extension_header>()->size;
+                        break;
+                    case object_kind::string:
+                        data_length = e.get_if<string_header>()->size;
+                        break;
+                    case object_kind::data_buffer:
+                        data_length -= uint32_t(e.get_if<cbuffer>()->size());
+                        break;
+                    default:
+                        break;
+                }
+                if(!data_length)
+                    --remaining_items;
+            }
         }
 
-        inline auto tag_invoke(tag_t<serial_event_sink>,type_tag_t<bool>) noexcept
+        // Skips the next value of a source. Sources that implement skip_value() themselves,
+        // like span_parser and parser_event_source, do so without producing any events for it.
+        auto skip_value(pmr_system_executor ex,event_source auto& source)
         {
-            return [](pmr_system_executor,event_source auto& source,bool& x) -> async_event_consumer {
-                x = *expect_event<bool>(co_await source,{object_kind::bool_}).template get_if<bool>();
-            };
+            if constexpr(requires { source.skip_value(); }){
+                if constexpr(std::is_void_v<decltype(source.skip_value())>){
+                    source.skip_value();
+                    return stdcoro::suspend_never{};
+                }else
+                    return source.skip_value();
+            }else
+                return skip_events(ex,source);
         }
 
-        template<integral T>
-        auto tag_invoke(tag_t<serial_event_sink>,type_tag_t<T>) noexcept
+        template<typename T>
+        concept scalar_deserializable = std::is_same_v<T,std::nullptr_t>||std::is_same_v<T,bool>||
+                                        arithmetic<T>||std::is_same_v<T,timestamp_t>;
+
+        template<scalar_deserializable T>
+        void assign_scalar(event* e,T& x)
         {
-            return [](pmr_system_executor,event_source auto& source,T& x) -> async_event_consumer {
-                event e = expect_event<T>(co_await source,
-                                        {object_kind::unsigned_int,object_kind::signed_int});
+            if constexpr(std::is_same_v<T,std::nullptr_t>)
+                expect_event<std::nullptr_t>(e,{object_kind::null});
+            else if constexpr(std::is_same_v<T,bool>)
+                x = *expect_event<bool>(e,{object_kind::bool_}).template get_if<bool>();
+            else if constexpr(integral<T>){
+                event ev = expect_event<T>(e,{object_kind::unsigned_int,object_kind::signed_int});
                 auto throw_out_of_range = [&]{
                     throw structure_error{structure_error::reason_t::out_of_range,
-                                        boost::typeindex::type_id<T>(),{},std::move(e)};
+                                        boost::typeindex::type_id<T>(),{},std::move(ev)};
                 };
-                if(e.kind()==object_kind::unsigned_int){
-                    uint64_t v = *e.get_if<uint64_t>();
+                if(ev.kind()==object_kind::unsigned_int){
+                    uint64_t v = *ev.get_if<uint64_t>();
                     if(std::cmp_greater(v,std::numeric_limits<T>::max()))
                         throw_out_of_range();
                     x = T(v);
                 }else{
-                    int64_t v = *e.get_if<int64_t>();
+                    int64_t v = *ev.get_if<int64_t>();
                     if(std::cmp_greater(v,std::numeric_limits<T>::max())||
                             std::cmp_less(v,std::numeric_limits<T>::lowest()))
                         throw_out_of_range();
                     x = T(v);
                 }
-            };
+            }else if constexpr(std::is_same_v<T,float>)
+                x = *expect_event<float>(e,{object_kind::float_}).template get_if<float>();
+            else if constexpr(std::is_same_v<T,double>)
+                x = *expect_event<double>(e,{object_kind::double_}).template get_if<double>();
+            else
+                x = *expect_event<timestamp_t>(e,{object_kind::timestamp}).
+                        template get_if<timestamp_t>();
         }
 
-        inline auto tag_invoke(tag_t<serial_event_sink>,type_tag_t<float>) noexcept
+        template<scalar_deserializable T>
+        auto tag_invoke(tag_t<serial_event_sink>,type_tag_t<T>) noexcept
         {
-            return [](pmr_system_executor,event_source auto& source,float& x) -> async_event_consumer {
-                x = *expect_event<float>(co_await source,{object_kind::float_}).template get_if<float>();
+            return [](pmr_system_executor,event_source auto& source,T& x) -> async_event_consumer {
+                assign_scalar(co_await source,x);
             };
         }
 
-        inline auto tag_invoke(tag_t<serial_event_sink>,type_tag_t<double>) noexcept
+        // Scalar elements of containers are assigned inline from the next event
+        // instead of starting a sink coroutine per element.
+        template<typename Awaiter,typename T>
+        struct scalar_sink_awaiter : awaiter_wrapper<Awaiter>
         {
-            return [](pmr_system_executor,event_source auto& source,double& x) -> async_event_consumer {
-                x = *expect_event<double>(co_await source,{object_kind::double_}).template get_if<double>();
-            };
-        }
+            T& x_;
 
-        inline auto tag_invoke(tag_t<serial_event_sink>,type_tag_t<timestamp_t>) noexcept
+            void await_resume()
+            {
+                assign_scalar(this->a_.await_resume(),x_);
+            }
+        };
+
+        template<deserializable T>
+        auto sink_element(pmr_system_executor ex,event_source auto& source,T& x)
         {
-            return [](pmr_system_executor,event_source auto& source,timestamp_t& x) -> async_event_consumer {
-                x = *expect_event<timestamp_t>(co_await source,{object_kind::timestamp}).
-                        template get_if<timestamp_t>();
-            };
+            if constexpr(scalar_deserializable<T>)
+                return scalar_sink_awaiter<awaiter_type_t<decltype(source)>,T>{{get_awaiter(source)},x};
+            else
+                return serial_event_sink(type_tag<T>)(ex,source,x);
         }
 
         template<typename Allocator>
@@ -307,7 +360,6 @@ namespace ampi
                 if(std::cmp_greater(s,std::numeric_limits<size_type>::max()))
                     throw_out_of_range();
                 auto n = size_type(s);
-                auto ses = serial_event_sink(type_tag<container_value_type_t<T>>);
                 if constexpr(resizeable_container_like<T>||
                         (!emplace_back_container_like<T>&&!set_container_like<T>)){
                     if constexpr(resizeable_container_like<T>)
@@ -315,15 +367,15 @@ namespace ampi
                     else if(n!=std::size(x))
                         throw_out_of_range();
                     for(auto& e:x)
-                        co_await ses(ex,source,e);
+                        co_await sink_element(ex,source,e);
                 }else{
                     x.clear();
                     for(size_type i=0;i<n;++i)
                         if constexpr(emplace_back_container_like<T>)
-                            co_await ses(ex,source,x.emplace_back());
+                            co_await sink_element(ex,source,x.emplace_back());
                         else{
                             typename T::value_type v;
-                            co_await ses(ex,source,v);
+                            co_await sink_element(ex,source,v);
                             check_unique_key<T>(x.emplace(std::move(v)));
                         }
                 }
@@ -346,19 +398,21 @@ namespace ampi
                 auto n = size_type(s);
                 using key_type = std::remove_const_t<map_like_key_type<T>>;
                 using mapped_type = map_like_mapped_type<T>;
-                auto sesk = serial_event_sink(type_tag<key_type>);
-                auto sesv = serial_event_sink(type_tag<mapped_type>);
                 x.clear();
                 for(size_type i=0;i<n;++i){
                     key_type k;
-                    co_await sesk(ex,source,k);
+                    co_await sink_element(ex,source,k);
                     mapped_type v;
-                    co_await sesv(ex,source,v);
+                    co_await sink_element(ex,source,v);
                     check_unique_key<T>(x.emplace(std::move(k),std::move(v)));
                 }
             };
         }
     }
+
+    template<typename Awaiter,typename T>
+    struct is_asymmetric_awaitable<serial_event_sink_ns::scalar_sink_awaiter<Awaiter,T>>
+        : is_asymmetric_awaitable<Awaiter> {};
 }
 
 #endif
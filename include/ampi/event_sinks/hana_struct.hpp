@@ -8,6 +8,7 @@
 #define UUID_7B932D1F_C39D_43A5_9121_C225BC83858F
 
 #include <ampi/detail/hana_struct.hpp>
+#include <ampi/direct_decoders/hana_struct.hpp>
 #include <ampi/event_sinks/event_sink.hpp>
 
 #include <bitset>
@@ -50,7 +51,7 @@ namespace ampi::serial_event_sink_ns
                 event e = expect_event<T>(co_await source,{object_kind::map});
                 uint32_t n = e.get_if<map_header>()->size;
                 constexpr size_t s = boost::hana::size(a);
-                if(n>s)
+                if(!ignore_unknown_keys<T>::value&&n>s)
                     throw structure_error{structure_error::reason_t::out_of_range,
                                           boost::typeindex::type_id<T>(),
                                           {object_kind::sequence},std::move(e)};
@@ -116,9 +117,13 @@ namespace ampi::serial_event_sink_ns
                     name_coro = str_ses(ex,source,name);
                     co_await std::move(name_coro);
                     if(!(...||(matched_name(boost::hana::size_c<Indices>,name)&&
-                           (co_await get_ses(boost::hana::size_c<Indices>),true))))
-                        throw structure_error{structure_error::reason_t::unknown_key,
-                                              boost::typeindex::type_id<T>(),{},std::move(e)};
+                           (co_await get_ses(boost::hana::size_c<Indices>),true)))){
+                        if constexpr(!ignore_unknown_keys<T>::value)
+                            throw structure_error{structure_error::reason_t::unknown_key,
+                                                  boost::typeindex::type_id<T>(),{},std::move(e)};
+                        else
+                            co_await skip_value(ex,source);
+                    }
                 }
             };
         }(std::make_index_sequence<boost::hana::size(boost::hana::accessors<T>())>{});
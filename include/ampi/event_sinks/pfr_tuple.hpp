@@ -8,6 +8,7 @@
 #define UUID_903043EF_DFE0_45A3_BF59_8E6B36BB409B
 
 #include <ampi/detail/pfr_tuple.hpp>
+#include <ampi/direct_decoders/pfr_tuple.hpp>
 #include <ampi/event_sinks/event_sink.hpp>
 
 namespace ampi::serial_event_sink_ns
@@ -8,6 +8,7 @@
 #define UUID_13F2D7C4_24A6_4B8C_AF92_A2BA749D05E3
 
 #include <ampi/detail/hana_struct.hpp>
+#include <ampi/direct_encoders/hana_struct.hpp>
 #include <ampi/event_sources/event_source.hpp>
 
 namespace ampi::serial_event_source_ns
@@ -8,6 +8,7 @@
 #define UUID_19B40254_9008_410C_8A33_95B207448929
 
 #include <ampi/detail/pfr_tuple.hpp>
+#include <ampi/direct_encoders/pfr_tuple.hpp>
 #include <ampi/event_sources/event_source.hpp>
 
 namespace ampi::serial_event_source_ns
@@ -10,8 +10,14 @@
 #include <ampi/buffer_sources/buffer_source.hpp>
 #include <ampi/event.hpp>
 
+#include <boost/container/container_fwd.hpp>
 #include <boost/endian/conversion.hpp>
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <ranges>
+
 namespace ampi
 {
     namespace detail
@@ -24,182 +30,388 @@ namespace ampi
         }
     }
 
-    template<executor Executor>
-    async_generator<cbuffer,Executor> emitter(Executor /*ex*/,event_source auto& es,
-                                              buffer_factory auto& bf)
+    namespace detail
     {
-        auto write_byte = [&](byte b){
-            buffer buf = bf.get_buffer(1);
-            buf[0] = b;
-            return buf;
-        };
-        auto write_big_endian = [&](byte prefix,auto x){
-            buffer buf = bf.get_buffer(1+sizeof(decltype(x)));
-            buf[0] = prefix;
-            detail::put_big_endian(buf.data()+1,x);
-            return buf;
-        };
-        auto write_124 = [&](uint8_t prefix_base,uint32_t size){
-            buffer buf;
+        // Encoders of single headers and scalars into space for n bytes returned by alloc(n).
+
+        template<typename Alloc>
+        void encode_big_endian(byte prefix,auto x,Alloc&& alloc)
+        {
+            byte* p = alloc(1+sizeof(decltype(x)));
+            p[0] = prefix;
+            put_big_endian(p+1,x);
+        }
+
+        template<typename Alloc>
+        void encode_null(Alloc&& alloc)
+        {
+            *alloc(1) = byte{0xc0};
+        }
+
+        template<typename Alloc>
+        void encode_bool(bool x,Alloc&& alloc)
+        {
+            *alloc(1) = byte{uint8_t(0xc2+x)};
+        }
+
+        template<typename Alloc>
+        void encode_unsigned(uint64_t x,Alloc&& alloc)
+        {
+            if(x<=0x7f)
+                *alloc(1) = byte{uint8_t(x)};
+            else if(x<=0xff)
+                encode_big_endian(byte{0xcc},uint8_t(x),alloc);
+            else if(x<=0xffff)
+                encode_big_endian(byte{0xcd},uint16_t(x),alloc);
+            else if(x<=0xffffffff)
+                encode_big_endian(byte{0xce},uint32_t(x),alloc);
+            else
+                encode_big_endian(byte{0xcf},uint64_t(x),alloc);
+        }
+
+        template<typename Alloc>
+        void encode_signed(int64_t x,Alloc&& alloc)
+        {
+            if(x>=0)
+                encode_unsigned(uint64_t(x),alloc);
+            else if(x>=-0x20)
+                *alloc(1) = byte{uint8_t(x)};
+            else if(x>=-0x80)
+                encode_big_endian(byte{0xd0},uint8_t(x),alloc);
+            else if(x>=-int32_t(0x8000))
+                encode_big_endian(byte{0xd1},uint16_t(x),alloc);
+            else if(x>=-int64_t(0x80000000))
+                encode_big_endian(byte{0xd2},uint32_t(x),alloc);
+            else
+                encode_big_endian(byte{0xd3},uint64_t(x),alloc);
+        }
+
+        template<typename Alloc>
+        void encode_float(float x,Alloc&& alloc)
+        {
+            encode_big_endian(byte{0xca},x,alloc);
+        }
+
+        template<typename Alloc>
+        void encode_double(double x,Alloc&& alloc)
+        {
+            encode_big_endian(byte{0xcb},x,alloc);
+        }
+
+        template<typename Alloc>
+        void encode_container_header(bool is_map,uint32_t n,Alloc&& alloc)
+        {
+            if(n<=0xf)
+                *alloc(1) = byte{uint8_t((0x90^uint8_t(is_map<<4))|n)};
+            else if(n<=0xffff)
+                encode_big_endian(byte{uint8_t(0xdc|(is_map<<1))},uint16_t(n),alloc);
+            else
+                encode_big_endian(byte{uint8_t(0xdd|(is_map<<1))},n,alloc);
+        }
+
+        template<typename Alloc>
+        void encode_124_header(uint8_t prefix_base,uint32_t size,Alloc&& alloc)
+        {
             if(size<=0xff){
-                buf = bf.get_buffer(1+1);
-                buf[0] = byte{prefix_base};
-                buf[1] = byte{uint8_t(size)};
-            }else if(size<=0xffff){
-                buf = bf.get_buffer(1+2);
-                buf[0] = byte{uint8_t(prefix_base+1)};
-                detail::put_big_endian(buf.data()+1,uint16_t(size));
+                byte* p = alloc(1+1);
+                p[0] = byte{prefix_base};
+                p[1] = byte{uint8_t(size)};
+            }else if(size<=0xffff)
+                encode_big_endian(byte{uint8_t(prefix_base+1)},uint16_t(size),alloc);
+            else
+                encode_big_endian(byte{uint8_t(prefix_base+2)},uint32_t(size),alloc);
+        }
+
+        template<typename Alloc>
+        void encode_string_header(uint32_t size,Alloc&& alloc)
+        {
+            if(size<=0x1f)
+                *alloc(1) = byte{uint8_t(0xa0+size)};
+            else
+                encode_124_header(0xd9,size,alloc);
+        }
+
+        template<typename Alloc>
+        void encode_binary_header(uint32_t size,Alloc&& alloc)
+        {
+            encode_124_header(0xc4,size,alloc);
+        }
+
+        template<typename Alloc>
+        void encode_extension_header(const extension_header& ext,Alloc&& alloc)
+        {
+            byte* p;
+            size_t n;
+            if(std::has_single_bit(ext.size)&&ext.size<=16){
+                p = alloc(n = 1+1);
+                p[0] = byte{uint8_t(0xd3+std::bit_width(ext.size))};
+            }else if(ext.size<=0xff){
+                p = alloc(n = 1+1+1);
+                p[0] = byte{0xc7};
+                p[1] = byte{uint8_t(ext.size)};
+            }else if(ext.size<=0xffff){
+                p = alloc(n = 1+2+1);
+                p[0] = byte{0xc8};
+                put_big_endian(p+1,uint16_t(ext.size));
             }else{
-                buf = bf.get_buffer(1+4);
-                buf[0] = byte{uint8_t(prefix_base+2)};
-                detail::put_big_endian(buf.data()+1,uint32_t(size));
+                p = alloc(n = 1+4+1);
+                p[0] = byte{0xc9};
+                put_big_endian(p+1,uint32_t(ext.size));
+            }
+            p[n-1] = byte{uint8_t(ext.type)};
+        }
+
+        template<typename Alloc>
+        void encode_timestamp(timestamp_t t,Alloc&& alloc)
+        {
+            int64_t ns = t.time_since_epoch().count(),
+                    s = ns/1'000'000'000;
+            ns %= 1'000'000'000;
+            if(ns<0){
+                --s;
+                ns += 1'000'000'000;
+            }
+            if(s>>34){
+                byte* p = alloc(1+1+1+4+8);
+                p[0] = byte{0xc7};
+                p[1] = byte{12};
+                p[2] = byte{uint8_t(-1)};
+                put_big_endian(p+1+1+1,uint32_t(ns));
+                put_big_endian(p+1+1+1+4,s);
+            }else{
+                uint64_t d = (uint64_t(ns)<<34)|uint64_t(s);
+                if(d>>32){
+                    byte* p = alloc(1+1+8);
+                    p[0] = byte{0xd7};
+                    p[1] = byte{uint8_t(-1)};
+                    put_big_endian(p+1+1,d);
+                }else{
+                    byte* p = alloc(1+1+4);
+                    p[0] = byte{0xd6};
+                    p[1] = byte{uint8_t(-1)};
+                    put_big_endian(p+1+1,uint32_t(d));
+                }
+            }
+        }
+
+        // Allocs may take data themselves with put_data(data,n) instead of returning space for it.
+        template<typename Alloc>
+        void encode_data(const void* data,size_t n,Alloc&& alloc)
+        {
+            if constexpr(requires { alloc.put_data(data,n); })
+                alloc.put_data(data,n);
+            else if(n)
+                std::memcpy(alloc(n),data,n);
+        }
+
+        // Alloc for encoders that only adds up the lengths they ask for.
+        // Headers are written to scratch space, data is not copied at all.
+        struct size_counter
+        {
+            size_t size = 0;
+            byte scratch[max_msgpack_fixed_buffer_length];
+
+            byte* operator()(size_t n) noexcept
+            {
+                size += n;
+                return scratch;
+            }
+
+            void put_data(const void* /*data*/,size_t n) noexcept
+            {
+                size += n;
             }
-            return buf;
         };
-        while(event* e = co_await es){
-            uint64_t x;
-            switch(e->kind()){
+
+        // Alloc for encoders that writes into a fixed span while the encoding fits,
+        // and only adds up the lengths afterwards, like size_counter.
+        struct span_writer
+        {
+            binary_view_t out;
+            size_t size = 0;
+            byte scratch[max_msgpack_fixed_buffer_length];
+
+            byte* operator()(size_t n) noexcept
+            {
+                byte* p = size+n<=out.size()?out.data()+size:scratch;
+                size += n;
+                return p;
+            }
+
+            void put_data(const void* data,size_t n) noexcept
+            {
+                if(n&&size+n<=out.size())
+                    std::memcpy(out.data()+size,data,n);
+                size += n;
+            }
+        };
+
+        template<typename Container>
+        concept resizable_byte_container = std::ranges::contiguous_range<Container>&&
+            sizeof(std::ranges::range_value_t<Container>)==1&&
+            requires(Container& cont,size_t n){
+                cont.resize(n);
+            };
+
+        // Space is written before it is read, so containers that can skip zeroing it do.
+        void resize_for_writing(resizable_byte_container auto& cont,size_t n)
+        {
+            if constexpr(requires{ cont.resize(n,boost::container::default_init); })
+                cont.resize(n,boost::container::default_init);
+            else
+                cont.resize(n);
+        }
+
+        // Alloc for encoders that appends to a contiguous container, growing it geometrically.
+        // The container has to be cut to size afterwards.
+        template<resizable_byte_container Container>
+        struct container_writer
+        {
+            Container& cont;
+            size_t size = std::size(cont);
+
+            byte* operator()(size_t n)
+            {
+                if(std::size(cont)-size<n)
+                    resize_for_writing(cont,std::max(size+n,2*std::size(cont)));
+                return reinterpret_cast<byte*>(std::data(cont))+std::exchange(size,size+n);
+            }
+
+            void finish()
+            {
+                cont.resize(size);
+            }
+        };
+
+        // Encodes an event other than data into space for n bytes returned by alloc(n).
+        template<typename Alloc>
+        void encode_header(const event& e,Alloc&& alloc)
+        {
+            switch(e.kind()){
                 case object_kind::null:
-                    co_yield write_byte(byte{0xc0});
+                    encode_null(alloc);
                     break;
                 case object_kind::bool_:
-                    co_yield write_byte(byte{uint8_t(0xc2+*e->get_if<bool>())});
+                    encode_bool(*e.get_if<bool>(),alloc);
                     break;
                 case object_kind::signed_int:
-                    if(int64_t sx = *e->get_if<int64_t>();sx<0){
-                        if(sx>=-0x20)
-                            co_yield write_byte(byte{uint8_t(sx)});
-                        else if(sx>=-0x80)
-                            co_yield write_big_endian(byte{0xd0},uint8_t(sx));
-                        else if(sx>=-int32_t(0x8000))
-                            co_yield write_big_endian(byte{0xd1},uint16_t(sx));
-                        else if(sx>=-int64_t(0x80000000))
-                            co_yield write_big_endian(byte{0xd2},uint32_t(sx));
-                        else
-                            co_yield write_big_endian(byte{0xd3},uint64_t(sx));
-                        break;
-                    }else{
-                        x = uint64_t(sx);
-                        goto have_positive;
-                    }
+                    encode_signed(*e.get_if<int64_t>(),alloc);
+                    break;
                 case object_kind::unsigned_int:
-                    {
-                        x = *e->get_if<uint64_t>();
-have_positive:
-                        if(x<=0x7f)
-                            co_yield write_byte(byte{uint8_t(x)});
-                        else if(x<=0xff)
-                            co_yield write_big_endian(byte{0xcc},uint8_t(x));
-                        else if(x<=0xffff)
-                            co_yield write_big_endian(byte{0xcd},uint16_t(x));
-                        else if(x<=0xffffffff)
-                            co_yield write_big_endian(byte{0xce},uint32_t(x));
-                        else
-                            co_yield write_big_endian(byte{0xcf},uint64_t(x));
-                    }
+                    encode_unsigned(*e.get_if<uint64_t>(),alloc);
                     break;
                 case object_kind::float_:
-                    co_yield write_big_endian(byte{0xca},*e->get_if<float>());
+                    encode_float(*e.get_if<float>(),alloc);
                     break;
                 case object_kind::double_:
-                    co_yield write_big_endian(byte{0xcb},*e->get_if<double>());
+                    encode_double(*e.get_if<double>(),alloc);
                     break;
                 case object_kind::sequence:
+                    encode_container_header(false,e.get_if<sequence_header>()->size,alloc);
+                    break;
                 case object_kind::map:
-                    {
-                        bool is_map = e->kind()==object_kind::map;
-                        uint32_t n = is_map?
-                            e->get_if<map_header>()->size:
-                            e->get_if<sequence_header>()->size;
-                        if(n<=0xf)
-                            co_yield write_byte(byte{uint8_t((0x90^uint8_t(is_map<<4))|n)});
-                        else if(n<=0xffff)
-                            co_yield write_big_endian(byte{uint8_t(0xdc|(is_map<<1))},
-                                                        uint16_t(n));
-                        else
-                            co_yield write_big_endian(byte{uint8_t(0xdd|(is_map<<1))},n);
-                    }
+                    encode_container_header(true,e.get_if<map_header>()->size,alloc);
                     break;
                 case object_kind::string:
-                    {
-                        uint32_t size = e->get_if<string_header>()->size;
-                        if(size<=0x1f)
-                            co_yield write_byte(byte{uint8_t(0xa0+size)});
-                        else
-                            co_yield write_124(0xd9,size);
-                    }
+                    encode_string_header(e.get_if<string_header>()->size,alloc);
                     break;
                 case object_kind::binary:
-                    co_yield write_124(0xc4,e->get_if<binary_header>()->size);
+                    encode_binary_header(e.get_if<binary_header>()->size,alloc);
                     break;
                 case object_kind::extension:
-                    {
-                        auto& ext = *e->get_if<extension_header>();
-                        buffer buf;
-                        if(std::has_single_bit(ext.size)&&ext.size<=16){
-                            buf = bf.get_buffer(1+1);
-                            buf[0] = byte{uint8_t(0xd3+std::bit_width(ext.size))};
-                        }else if(ext.size<=0xff){
-                            buf = bf.get_buffer(1+1+1);
-                            buf[0] = byte{0xc7};
-                            buf[1] = byte{uint8_t(ext.size)};
-                        }else if(ext.size<=0xffff){
-                            buf = bf.get_buffer(1+2+1);
-                            buf[0] = byte{0xc8};
-                            detail::put_big_endian(buf.data()+1,uint16_t(ext.size));
-                        }else{
-                            buf = bf.get_buffer(1+4+1);
-                            buf[0] = byte{0xc9};
-                            detail::put_big_endian(buf.data()+1,uint32_t(ext.size));
-                        }
-                        buf[buf.size()-1] = byte{uint8_t(ext.type)};
-                        co_yield std::move(buf);
-                    }
+                    encode_extension_header(*e.get_if<extension_header>(),alloc);
                     break;
-                case object_kind::timestamp:
-                    {
-                        int64_t ns = e->get_if<timestamp_t>()->time_since_epoch().count(),
-                                s = ns/1'000'000'000;
-                        ns %= 1'000'000'000;
-                        if(ns<0){
-                            --s;
-                            ns += 1'000'000'000;
-                        }
-                        buffer buf;
-                        if(s>>34){
-                            buf= bf.get_buffer(1+1+1+4+8);
-                            buf[0] = byte{0xc7};
-                            buf[1] = byte{12};
-                            buf[2] = byte{uint8_t(-1)};
-                            detail::put_big_endian(buf.data()+1+1+1,uint32_t(ns));
-                            detail::put_big_endian(buf.data()+1+1+1+4,s);
-                        }else{
-                            uint64_t d = (uint64_t(ns)<<34)|uint64_t(s);
-                            if(d>>32){
-                                buf = bf.get_buffer(1+1+8);
-                                buf[0] = byte{0xd7};
-                                buf[1] = byte{uint8_t(-1)};
-                                detail::put_big_endian(buf.data()+1+1,d);
-                            }else{
-                                buf = bf.get_buffer(1+1+4);
-                                buf[0] = byte{0xd6};
-                                buf[1] = byte{uint8_t(-1)};
-                                detail::put_big_endian(buf.data()+1+1,uint32_t(d));
-                            }
-                        }
-                        co_yield std::move(buf);
-                    }
-                    break;
-                default: // case object_kind::data_buffer:
-                    co_yield std::move(*e->get_if<cbuffer>());
+                default: // case object_kind::timestamp:
+                    encode_timestamp(*e.get_if<timestamp_t>(),alloc);
             }
         }
     }
 
+    template<executor Executor>
+    async_generator<cbuffer,Executor> emitter(Executor /*ex*/,event_source auto& es,
+                                              buffer_factory auto& bf)
+    {
+        while(event* e = co_await es)
+            if(auto data = e->get_if<cbuffer>())
+                co_yield std::move(*data);
+            else{
+                buffer buf;
+                detail::encode_header(*e,[&](size_t n){
+                    buf = bf.get_buffer(n);
+                    return buf.data();
+                });
+                co_yield std::move(buf);
+            }
+    }
+
     async_generator<cbuffer> emitter(event_source auto& es,buffer_factory auto& bf)
     {
         return emitter(boost::asio::system_executor{},es,bf);
     }
+
+    // Encodes all events of es into space returned by alloc like emitter does,
+    // but without yielding intermediate buffers.
+    template<executor Executor,typename Alloc>
+    coroutine<void,Executor> alloc_emitter(Executor /*ex*/,event_source auto& es,Alloc& alloc)
+    {
+        while(event* e = co_await es)
+            if(auto data = e->get_if<cbuffer>())
+                detail::encode_data(data->data(),data->size(),alloc);
+            else
+                detail::encode_header(*e,alloc);
+    }
+
+    constexpr inline size_t default_packing_chunk_size = 0x1000,
+                            default_packing_inline_threshold = 0x100;
+
+    // Like emitter, but encodes headers and copies data pieces shorter than inline_threshold
+    // into chunks of chunk_size bytes from bf, yielding them once they fill up instead of
+    // every header separately. Larger data pieces are passed through without copying,
+    // after the filled part of the current chunk. A chunk is not written to after being
+    // yielded, so bf may reuse memory once yielded buffers have been consumed.
+    template<executor Executor>
+    async_generator<cbuffer,Executor> packing_emitter(Executor /*ex*/,event_source auto& es,
+            buffer_factory auto& bf,size_t chunk_size = default_packing_chunk_size,
+            size_t inline_threshold = default_packing_inline_threshold)
+    {
+        assert(max_msgpack_fixed_buffer_length<=chunk_size&&inline_threshold<=chunk_size);
+        buffer chunk;
+        size_t used = 0;
+        auto flush = [&]{
+            return cbuffer{std::move(chunk),0,std::exchange(used,0)};
+        };
+        while(event* e = co_await es){
+            auto data = e->get_if<cbuffer>();
+            if(data&&data->size()>=inline_threshold){
+                if(used)
+                    co_yield flush();
+                co_yield std::move(*data);
+                continue;
+            }
+            size_t n = data?data->size():max_msgpack_fixed_buffer_length;
+            if(chunk.size()-used<n){
+                if(used)
+                    co_yield flush();
+                chunk = bf.get_buffer(chunk_size);
+            }
+            if(data){
+                std::memcpy(chunk.data()+used,data->data(),n);
+                used += n;
+            }else
+                detail::encode_header(*e,[&](size_t k){
+                    return chunk.data()+std::exchange(used,used+k);
+                });
+        }
+        if(used)
+            co_yield flush();
+    }
+
+    async_generator<cbuffer> packing_emitter(event_source auto& es,buffer_factory auto& bf,
+            size_t chunk_size = default_packing_chunk_size,
+            size_t inline_threshold = default_packing_inline_threshold)
+    {
+        return packing_emitter(boost::asio::system_executor{},es,bf,chunk_size,inline_threshold);
+    }
 }
 
 #endif
@@ -0,0 +1,130 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_3E8B51D7_26AC_4F90_9B4E_D1A7C6052F83
+#define UUID_3E8B51D7_26AC_4F90_9B4E_D1A7C6052F83
+
+#include <ampi/filters/parser.hpp>
+
+namespace ampi
+{
+    struct message_boundary
+    {
+        enum struct status_t : uint8_t
+        {
+            complete,
+            incomplete,
+            malformed
+        };
+
+        status_t status;
+        // Set for malformed messages.
+        parser_error::reason_t reason = {};
+        // For complete messages, the number of bytes of input belonging to the message.
+        // For incomplete ones, the number of bytes that are at least needed to continue.
+        // For malformed ones, the number of bytes of input that have been examined.
+        size_t length;
+    };
+
+    // Finds the end of a top-level object fed to it in pieces, checking that it is well-formed
+    // by the same rules as parser, but without producing events, allocating or throwing.
+    // After a complete or malformed result, reset() is needed to validate the next object.
+    class message_validator
+    {
+    public:
+        explicit message_validator(parser_options options = {}) noexcept
+            : options_{options}
+        {}
+
+        message_boundary feed(binary_cview_t data) noexcept
+        {
+            using status = message_boundary::status_t;
+            if(error_)
+                return {status::malformed,*error_,0};
+            size_t pos = 0;
+            while(remaining_items_){
+                size_t avail = data.size()-pos;
+                if(data_length_){
+                    if(!avail)
+                        return {status::incomplete,{},data_length_};
+                    size_t c = std::min<size_t>(data_length_,avail);
+                    const char* chars = reinterpret_cast<const char*>(data.data()+pos);
+                    if(check_utf8_)
+                        if(const char* bad = u8v_({chars,c}))
+                            return fail(parser_error::reason_t::invalid_utf8,pos+size_t(bad-chars));
+                    pos += c;
+                    data_length_ -= uint32_t(c);
+                    if(!data_length_){
+                        if(check_utf8_&&!u8v_)
+                            return fail(parser_error::reason_t::invalid_utf8,pos);
+                        --remaining_items_;
+                    }
+                    continue;
+                }
+                const byte* p;
+                size_t n;
+                if(!header_length_&&avail&&(n = detail::header_size(data.data()+pos,avail))<=avail){
+                    p = data.data()+pos;
+                    pos += n;
+                }else{
+                    for(n=header_length_?detail::header_size(header_,header_length_):1;
+                            header_length_<n;n=detail::header_size(header_,header_length_)){
+                        if(pos==data.size())
+                            return {status::incomplete,{},n-header_length_};
+                        size_t c = std::min(n-header_length_,data.size()-pos);
+                        std::memcpy(header_+header_length_,data.data()+pos,c);
+                        pos += c;
+                        header_length_ += uint8_t(c);
+                    }
+                    header_length_ = 0;
+                    p = header_;
+                }
+                auto h = detail::measure_header(p);
+                if(h.error)
+                    return fail(*h.error,pos);
+                remaining_items_ += h.items;
+                data_length_ = h.data_length;
+                if(data_length_){
+                    check_utf8_ = h.string&&!(options_&parser_option::skip_utf8_validation);
+                    u8v_.reset();
+                }else
+                    --remaining_items_;
+            }
+            return {status::complete,{},pos};
+        }
+
+        void reset() noexcept
+        {
+            remaining_items_ = 1;
+            data_length_ = 0;
+            header_length_ = 0;
+            error_.reset();
+        }
+    private:
+        uint64_t remaining_items_ = 1;
+        uint32_t data_length_ = 0;
+        parser_options options_;
+        bool check_utf8_ = false;
+        utf8_validator u8v_;
+        uint8_t header_length_ = 0;
+        optional<parser_error::reason_t> error_;
+        byte header_[detail::max_msgpack_header_length];
+
+        message_boundary fail(parser_error::reason_t reason,size_t length) noexcept
+        {
+            error_ = reason;
+            return {message_boundary::status_t::malformed,reason,length};
+        }
+    };
+
+    // Finds the end of the top-level object at the start of data.
+    inline message_boundary find_message_end(binary_cview_t data,parser_options options = {}) noexcept
+    {
+        return message_validator{options}.feed(data);
+    }
+}
+
+#endif
@@ -16,6 +16,10 @@
 
 #include <boost/endian/conversion.hpp>
 
+#include <array>
+#include <bit>
+#include <cassert>
+
 namespace ampi
 {
     class AMPI_EXPORT parser_error : public exception
@@ -47,6 +51,336 @@ namespace ampi
 
     using parser_options = flags<parser_option>;
 
+    namespace detail
+    {
+        inline optional<parser_error::reason_t> check_timestamp(int64_t s,uint32_t ns) noexcept
+        {
+            if(ns>999'999'999)
+                return parser_error::reason_t::invalid_timestamp_nanoseconds;
+            constexpr int64_t max_s = std::numeric_limits<int64_t>::max()/1'000'000'000,
+                              min_s = std::numeric_limits<int64_t>::lowest()/1'000'000'000-1;
+            constexpr uint32_t max_ns = uint32_t(std::numeric_limits<int64_t>::max()%1'000'000'000),
+                               min_ns = uint32_t(1'000'000'000-
+                                   std::numeric_limits<int64_t>::lowest()%1'000'000'000);
+            if(s>max_s||(s==max_s&&ns>max_ns)||s<min_s||(s==min_s&&ns<min_ns))
+                return parser_error::reason_t::unsupported_timestamp;
+            return {};
+        }
+
+        inline timestamp_t make_timestamp(int64_t s,uint32_t ns)
+        {
+            if(auto reason = check_timestamp(s,ns))
+                throw parser_error{*reason};
+            return timestamp_t{std::chrono::seconds{s}+std::chrono::nanoseconds{ns}};
+        }
+
+        template<typename T>
+        T load_big_endian(const byte* p) noexcept
+        {
+            return boost::endian::endian_load<T,sizeof(T),boost::endian::order::big>(
+                reinterpret_cast<const unsigned char*>(p));
+        }
+
+        inline uint32_t load_length(const byte* p,unsigned power) noexcept
+        {
+            switch(power){
+                case 0:
+                    return uint8_t(*p);
+                case 1:
+                    return load_big_endian<uint16_t>(p);
+                default:
+                    return load_big_endian<uint32_t>(p);
+            }
+        }
+
+        // Extension timestamp 96 with 32-bit length.
+        constexpr inline size_t max_msgpack_header_length = 1+4+1+12;
+
+        // Size of the fixed part of an object starting with a given leading byte:
+        // the leading byte itself, length/count fields, extension type and payload
+        // of numbers. Variable-length data is not included, neither is timestamp payload,
+        // which depends on extension type, see header_size.
+        constexpr inline auto leading_byte_sizes = []{
+            std::array<uint8_t,256> sizes{};
+            for(unsigned b=0;b<256;++b)
+                sizes[b] = b<0xc4||b>=0xe0?1:
+                           b<0xc7?uint8_t(1+(1u<<(b-0xc4))):
+                           b<0xca?uint8_t(1+(1u<<(b-0xc7))+1):
+                           b<0xd4?uint8_t(1+(1u<<(b&3))):
+                           b<0xd9?2:
+                           b<0xdc?uint8_t(1+(1u<<(b-0xd9))):
+                           b<0xde?uint8_t(1+(2u<<(b-0xdc))):
+                                  uint8_t(1+(2u<<(b-0xde)));
+            // 0xca/0xcb are float/double, which don't fit the integer pattern above.
+            sizes[0xca] = 1+4;
+            sizes[0xcb] = 1+8;
+            return sizes;
+        }();
+
+        static_assert(leading_byte_sizes[0xcc]==2&&leading_byte_sizes[0xcf]==9&&
+                      leading_byte_sizes[0xd0]==2&&leading_byte_sizes[0xd3]==9&&
+                      leading_byte_sizes[0xc9]==6&&leading_byte_sizes[0xdf]==5);
+
+        // Number of bytes needed to decode a header, given n>0 bytes available at p.
+        // For extensions, the result may grow once the extension type becomes available.
+        inline size_t header_size(const byte* p,size_t n) noexcept
+        {
+            auto first_byte = uint8_t(*p);
+            size_t s = leading_byte_sizes[first_byte];
+            if(n<s)
+                return s;
+            if(first_byte>=0xc7&&first_byte<0xca){
+                if(int8_t(p[s-1])==-1&&load_length(p+1,first_byte-0xc7u)==12)
+                    s += 12;
+            }else if(first_byte>=0xd4&&first_byte<0xd9){
+                if(int8_t(p[1])==-1&&(first_byte==0xd6||first_byte==0xd7))
+                    s += 1u<<(first_byte-0xd4);
+            }
+            return s;
+        }
+
+        struct decoded_header
+        {
+            event e;
+            // Number of objects nested directly into this one, 2 per key-value pair for maps.
+            uint64_t items = 0;
+            // Length of string, binary or extension data following the header.
+            uint32_t data_length = 0;
+            bool string = false;
+        };
+
+        // Decodes a header from header_size(p,n) bytes at p,
+        // yielding the same events as parser::operator().
+        inline decoded_header decode_header(const byte* p)
+        {
+            auto first_byte = uint8_t(*p);
+            if(first_byte<0x80)
+                return {uint64_t(first_byte)};
+            if(first_byte>=0xe0)
+                return {int64_t(int8_t(first_byte))};
+            if(first_byte<0x90)
+                return {map_header{first_byte&0xfu},(first_byte&0xfu)*2ull};
+            if(first_byte<0xa0)
+                return {sequence_header{first_byte&0xfu},first_byte&0xfu};
+            if(first_byte<0xc0)
+                return {string_header{first_byte&0x1fu},0,first_byte&0x1fu,true};
+            switch(first_byte){
+                case 0xc0:
+                    return {nullptr};
+                case 0xc1:
+                    throw parser_error{parser_error::reason_t::invalid_leading_byte};
+                case 0xc2:
+                case 0xc3:
+                    return {bool(first_byte&1)};
+                case 0xc4:
+                case 0xc5:
+                case 0xc6:
+                    {
+                        uint32_t n = load_length(p+1,first_byte-0xc4u);
+                        return {binary_header{n},0,n};
+                    }
+                case 0xc7:
+                case 0xc8:
+                case 0xc9:
+                    {
+                        unsigned power = first_byte-0xc7u;
+                        uint32_t n = load_length(p+1,power);
+                        auto type = int8_t(p[1+(1u<<power)]);
+                        if(type!=-1)
+                            return {extension_header{n,type},0,n};
+                        if(n!=12)
+                            throw parser_error{parser_error::reason_t::invalid_timestamp_length};
+                        const byte* d = p+1+(1u<<power)+1;
+                        return {make_timestamp(load_big_endian<int64_t>(d+4),
+                                               load_big_endian<uint32_t>(d))};
+                    }
+                case 0xca:
+                    return {load_big_endian<float>(p+1)};
+                case 0xcb:
+                    return {load_big_endian<double>(p+1)};
+                case 0xcc:
+                    return {uint64_t(load_big_endian<uint8_t>(p+1))};
+                case 0xcd:
+                    return {uint64_t(load_big_endian<uint16_t>(p+1))};
+                case 0xce:
+                    return {uint64_t(load_big_endian<uint32_t>(p+1))};
+                case 0xcf:
+                    return {load_big_endian<uint64_t>(p+1)};
+                case 0xd0:
+                    return {int64_t(load_big_endian<int8_t>(p+1))};
+                case 0xd1:
+                    return {int64_t(load_big_endian<int16_t>(p+1))};
+                case 0xd2:
+                    return {int64_t(load_big_endian<int32_t>(p+1))};
+                case 0xd3:
+                    return {load_big_endian<int64_t>(p+1)};
+                case 0xd4:
+                case 0xd5:
+                case 0xd6:
+                case 0xd7:
+                case 0xd8:
+                    {
+                        uint32_t n = 1u<<(first_byte-0xd4);
+                        auto type = int8_t(p[1]);
+                        if(type!=-1)
+                            return {extension_header{n,type},0,n};
+                        if(n==4)
+                            return {timestamp_t{std::chrono::seconds{load_big_endian<uint32_t>(p+2)}}};
+                        if(n==8){
+                            auto t = load_big_endian<uint64_t>(p+2);
+                            return {make_timestamp(int64_t(t&0x3ffffffff),uint32_t(t>>34))};
+                        }
+                        throw parser_error{parser_error::reason_t::invalid_timestamp_length};
+                    }
+                case 0xd9:
+                case 0xda:
+                case 0xdb:
+                    {
+                        uint32_t n = load_length(p+1,first_byte-0xd9u);
+                        return {string_header{n},0,n,true};
+                    }
+                case 0xdc:
+                case 0xdd:
+                    {
+                        uint32_t n = load_length(p+1,first_byte-0xdbu);
+                        return {sequence_header{n},n};
+                    }
+                default:
+                    {
+                        uint32_t n = load_length(p+1,first_byte-0xddu);
+                        return {map_header{n},n*2ull};
+                    }
+            }
+        }
+
+        struct header_extent
+        {
+            uint64_t items = 0;
+            uint32_t data_length = 0;
+            bool string = false;
+            optional<parser_error::reason_t> error = {};
+        };
+
+        // Checks a header from header_size(p,n) bytes at p like decode_header,
+        // but only finds out what follows it, without making an event or throwing.
+        inline header_extent measure_header(const byte* p) noexcept
+        {
+            auto first_byte = uint8_t(*p);
+            if(first_byte<0x80||first_byte>=0xe0)
+                return {};
+            if(first_byte<0x90)
+                return {(first_byte&0xfu)*2ull};
+            if(first_byte<0xa0)
+                return {first_byte&0xfu};
+            if(first_byte<0xc0)
+                return {0,first_byte&0x1fu,true};
+            if(first_byte==0xc1)
+                return {0,0,false,parser_error::reason_t::invalid_leading_byte};
+            if(first_byte<0xc4)
+                return {};
+            if(first_byte<0xc7)
+                return {0,load_length(p+1,first_byte-0xc4u)};
+            if(first_byte<0xca){
+                unsigned power = first_byte-0xc7u;
+                uint32_t n = load_length(p+1,power);
+                if(int8_t(p[1+(1u<<power)])!=-1)
+                    return {0,n};
+                if(n!=12)
+                    return {0,0,false,parser_error::reason_t::invalid_timestamp_length};
+                const byte* d = p+1+(1u<<power)+1;
+                return {0,0,false,check_timestamp(load_big_endian<int64_t>(d+4),
+                                                  load_big_endian<uint32_t>(d))};
+            }
+            if(first_byte<0xd4)
+                return {};
+            if(first_byte<0xd9){
+                uint32_t n = 1u<<(first_byte-0xd4);
+                if(int8_t(p[1])!=-1)
+                    return {0,n};
+                if(n==4)
+                    return {};
+                if(n==8)
+                    return {0,0,false,check_timestamp(0,uint32_t(load_big_endian<uint64_t>(p+2)>>34))};
+                return {0,0,false,parser_error::reason_t::invalid_timestamp_length};
+            }
+            if(first_byte<0xdc)
+                return {0,load_length(p+1,first_byte-0xd9u),true};
+            if(first_byte<0xde)
+                return {load_length(p+1,first_byte-0xdbu)};
+            return {load_length(p+1,first_byte-0xddu)*2ull};
+        }
+
+        // Size of the complete encoded value at the start of data.
+        inline size_t encoded_value_size(binary_cview_t data)
+        {
+            size_t pos = 0;
+            uint64_t remaining_items = 1;
+            do{
+                const byte* p = data.data()+pos;
+                size_t avail = data.size()-pos,
+                       n = avail?header_size(p,avail):1;
+                if(n>avail)
+                    throw parser_error{parser_error::reason_t::unexpected_end};
+                auto h = measure_header(p);
+                if(h.error)
+                    throw parser_error{*h.error};
+                if(avail-n<h.data_length)
+                    throw parser_error{parser_error::reason_t::unexpected_end};
+                pos += n+h.data_length;
+                remaining_items += h.items;
+            }while(--remaining_items);
+            return pos;
+        }
+
+        // Reads 1<<power bytes (sizeof(T) unless reading a length) directly from
+        // parser's current buffer without suspending if it has enough of them,
+        // only falling back to a subcoroutine that awaits more buffers otherwise.
+        template<typename Parser,typename T>
+        class parser_read_awaitable
+        {
+            using slow_t = subcoroutine<T,decltype(std::declval<const Parser&>().get_executor())>;
+        public:
+            parser_read_awaitable(Parser& p,uint8_t power = uint8_t(std::countr_zero(sizeof(T)))) noexcept
+                : p_{p},
+                  power_{power}
+            {}
+
+            bool await_ready()
+            {
+                size_t n = size_t(1)<<power_;
+                if(p_.buf_.size()<n){
+                    slow_.emplace(p_.template read_slow<T>(power_));
+                    slow_awaiter_.emplace(slow_->operator co_await());
+                    return false;
+                }
+                const byte* d = p_.buf_.data();
+                x_ = n==sizeof(T)?load_big_endian<T>(d):T(load_length(d,power_));
+                // Stealing the buffer avoids touching its reference count.
+                p_.buf_ = {std::move(p_.buf_),n};
+                return true;
+            }
+
+            auto await_suspend(stdcoro::coroutine_handle<> handle)
+            {
+                return slow_awaiter_->await_suspend(handle);
+            }
+
+            T await_resume()
+            {
+                return slow_awaiter_?slow_awaiter_->await_resume():x_;
+            }
+        private:
+            Parser& p_;
+            uint8_t power_;
+            T x_;
+            optional<slow_t> slow_;
+            optional<decltype(std::declval<slow_t&>().operator co_await())> slow_awaiter_;
+        };
+    }
+
+    template<typename Parser,typename T>
+    struct is_asymmetric_awaitable<detail::parser_read_awaitable<Parser,T>> : std::true_type {};
+
     template<buffer_source BufferSource,buffer_factory BufferFactory,
              executor Executor = boost::asio::system_executor>
     class parser
@@ -61,7 +395,193 @@ namespace ampi
 
         async_generator<event,Executor> operator()() [[clang::lifetimebound]]
         {
-            return [](Executor,parser& p) -> async_generator<event,Executor> {
+            return parse(false,false);
+        }
+
+        // Parses top-level objects one after another with a single long-lived generator,
+        // which yields nothing (its awaiter gets nullptr, see yield_nothing) after each of them
+        // before reading further input, and finishes once input ends between objects.
+        async_generator<event,Executor> messages() [[clang::lifetimebound]]
+        {
+            return parse(true,true);
+        }
+
+        // Like messages(), but goes on to the next object without yielding anything in between,
+        // for consumers that know where objects end, like sinks.
+        async_generator<event,Executor> consecutive() [[clang::lifetimebound]]
+        {
+            return parse(true,false);
+        }
+
+        // Yields events in batches of up to batch.size() non-empty spans of it. A batch is also
+        // handed over before awaiting more input, so that events of available data aren't delayed.
+        // Batches are invalidated when the generator is resumed.
+        async_generator<span<event>,Executor> batched(span<event> batch) [[clang::lifetimebound]]
+        {
+            assert(!batch.empty());
+            return [](Executor,parser& p,span<event> batch) -> async_generator<span<event>,Executor> {
+                uint64_t remaining_items = 1;
+                uint32_t data_length = 0;
+                bool check_utf8 = false;
+                utf8_validator u8v;
+                size_t k = 0;
+                do{
+                    if(k==batch.size()){
+                        co_yield batch.first(k);
+                        k = 0;
+                    }
+                    if(data_length){
+                        if(!p.buf_){
+                            if(k){
+                                co_yield batch.first(k);
+                                k = 0;
+                            }
+                            p.bf_.next_buffer_size(data_length);
+                            cbuffer* b = co_await p.bs_;
+                            if(!b)
+                                throw parser_error{parser_error::reason_t::unexpected_end};
+                            p.buf_ = std::move(*b);
+                        }
+                        size_t c = std::min<size_t>(data_length,p.buf_.size());
+                        cbuffer data{p.buf_,0,c};
+                        p.buf_ = {std::move(p.buf_),c};
+                        if(check_utf8&&
+                                u8v({reinterpret_cast<const char*>(data.data()),data.size()}))
+                            throw parser_error{parser_error::reason_t::invalid_utf8};
+                        data_length -= uint32_t(c);
+                        if(!data_length){
+                            if(check_utf8&&!u8v)
+                                throw parser_error{parser_error::reason_t::invalid_utf8};
+                            --remaining_items;
+                        }
+                        batch[k++] = std::move(data);
+                        continue;
+                    }
+                    detail::decoded_header h;
+                    size_t n;
+                    if(p.buf_&&(n = detail::header_size(p.buf_.data(),p.buf_.size()))<=p.buf_.size()){
+                        h = detail::decode_header(p.buf_.data());
+                        p.buf_ = {std::move(p.buf_),n};
+                    }else{
+                        // Header is split between buffers.
+                        byte merge_buf[detail::max_msgpack_header_length];
+                        size_t i = 0;
+                        for(n=1;i<n;n=detail::header_size(merge_buf,i)){
+                            if(!p.buf_){
+                                if(k){
+                                    co_yield batch.first(k);
+                                    k = 0;
+                                }
+                                p.bf_.next_buffer_size(n-i);
+                                cbuffer* b = co_await p.bs_;
+                                if(!b)
+                                    throw parser_error{parser_error::reason_t::unexpected_end};
+                                p.buf_ = std::move(*b);
+                            }
+                            size_t c = std::min(n-i,p.buf_.size());
+                            std::memcpy(merge_buf+i,p.buf_.data(),c);
+                            p.buf_ = {std::move(p.buf_),c};
+                            i += c;
+                        }
+                        h = detail::decode_header(merge_buf);
+                    }
+                    remaining_items += h.items;
+                    data_length = h.data_length;
+                    if(data_length){
+                        check_utf8 = h.string&&!(p.options_&parser_option::skip_utf8_validation);
+                        u8v.reset();
+                    }else
+                        --remaining_items;
+                    batch[k++] = std::move(h.e);
+                }while(remaining_items);
+                if(k)
+                    co_yield batch.first(k);
+            }(ex_,*this,batch);
+        }
+
+        // Steps over the next value without producing events for it or validating its strings,
+        // while a generator of this parser is suspended after the last event before that value.
+        // The generator accounts for the skipped value once it is resumed.
+        subcoroutine<void,Executor> skip_value() [[clang::lifetimebound]]
+        {
+            return [](Executor,parser& p) -> subcoroutine<void,Executor> {
+                uint64_t remaining_items = 1;
+                do{
+                    byte merge_buf[detail::max_msgpack_header_length];
+                    detail::header_extent h;
+                    size_t n;
+                    if(p.buf_&&(n = detail::header_size(p.buf_.data(),p.buf_.size()))<=p.buf_.size()){
+                        h = detail::measure_header(p.buf_.data());
+                        p.buf_ = {std::move(p.buf_),n};
+                    }else{
+                        // Header is split between buffers.
+                        size_t i = 0;
+                        for(n=1;i<n;n=detail::header_size(merge_buf,i)){
+                            if(!p.buf_){
+                                p.bf_.next_buffer_size(n-i);
+                                cbuffer* b = co_await p.bs_;
+                                if(!b)
+                                    throw parser_error{parser_error::reason_t::unexpected_end};
+                                p.buf_ = std::move(*b);
+                            }
+                            size_t c = std::min(n-i,p.buf_.size());
+                            std::memcpy(merge_buf+i,p.buf_.data(),c);
+                            p.buf_ = {std::move(p.buf_),c};
+                            i += c;
+                        }
+                        h = detail::measure_header(merge_buf);
+                    }
+                    if(h.error)
+                        throw parser_error{*h.error};
+                    for(uint32_t data_length=h.data_length;data_length;){
+                        if(!p.buf_){
+                            p.bf_.next_buffer_size(data_length);
+                            cbuffer* b = co_await p.bs_;
+                            if(!b)
+                                throw parser_error{parser_error::reason_t::unexpected_end};
+                            p.buf_ = std::move(*b);
+                        }
+                        size_t c = std::min<size_t>(data_length,p.buf_.size());
+                        p.buf_ = {std::move(p.buf_),c};
+                        data_length -= uint32_t(c);
+                    }
+                    remaining_items += h.items;
+                }while(--remaining_items);
+                ++p.skipped_;
+            }(ex_,*this);
+        }
+
+        Executor get_executor() const noexcept
+        {
+            return ex_;
+        }
+
+        void set_initial(cbuffer buf) noexcept
+        {
+            buf_ = std::move(buf);
+        }
+
+        cbuffer rest() noexcept
+        {
+            return std::move(buf_);
+        }
+    private:
+        BufferSource& bs_;
+        BufferFactory& bf_;
+        parser_options options_;
+        Executor ex_;
+        cbuffer buf_;
+        // Values stepped over by skip_value() since the generator was last resumed.
+        uint64_t skipped_ = 0;
+
+        template<typename,typename>
+        friend class detail::parser_read_awaitable;
+
+        async_generator<event,Executor> parse(bool persistent,bool mark_ends) [[clang::lifetimebound]]
+        {
+            return [](Executor,parser& p,bool persistent,bool mark_ends)
+                    -> async_generator<event,Executor> {
+                p.skipped_ = 0;
                 uint64_t remaining_items = 1;
                 auto do_sequence = [&](uint32_t n){
                     remaining_items += n;
@@ -71,20 +591,6 @@ namespace ampi
                     remaining_items += n*2ull;
                     return map_header{n};
                 };
-                auto do_timestamp = [](int64_t s,uint32_t ns){
-                    if(ns>999'999'999)
-                        throw parser_error{parser_error::reason_t::invalid_timestamp_nanoseconds};
-                    constexpr int64_t max_s = std::numeric_limits<int64_t>::max()/1'000'000'000,
-                                      min_s = std::numeric_limits<int64_t>::lowest()/1'000'000'000-1;
-                    constexpr uint32_t max_ns =
-                            uint32_t(std::numeric_limits<int64_t>::max()%1'000'000'000),
-                                       min_ns = uint32_t(1'000'000'000-
-                                     std::numeric_limits<int64_t>::lowest()%1'000'000'000);
-                    if(s>max_s||(s==max_s&&ns>max_ns)||s<min_s||(s==min_s&&ns<min_ns))
-                        throw parser_error{parser_error::reason_t::unsupported_timestamp};
-                    return timestamp_t{std::chrono::seconds{s}+
-                                       std::chrono::nanoseconds{ns}};
-                };
                 uint32_t data_length = 0;
                 bool string_data = false;
                 do{
@@ -118,7 +624,7 @@ namespace ampi
                                 throw parser_error{parser_error::reason_t::invalid_timestamp_length};
                             uint32_t ns = co_await p.get<uint32_t>();
                             int64_t s = co_await p.get<int64_t>();
-                            co_yield do_timestamp(s,ns);
+                            co_yield detail::make_timestamp(s,ns);
                         }else
                             co_yield extension_header{data_length,type};
                     }else if(first_byte==0xca){
@@ -167,7 +673,7 @@ namespace ampi
                                 case 8:
                                     {
                                         uint64_t t = co_await p.get<uint64_t>();
-                                        co_yield do_timestamp(t&0x3ffffffff,t>>34);
+                                        co_yield detail::make_timestamp(t&0x3ffffffff,t>>34);
                                     }
                                     break;
                                 default:
@@ -220,78 +726,243 @@ have_buffer:
                         }while(data_length);
                     }
                     string_data = false;
-                }while(--remaining_items);
-            }(ex_,*this);
+                    remaining_items -= 1+std::exchange(p.skipped_,0);
+                    if(!remaining_items&&persistent){
+                        if(mark_ends)
+                            co_yield yield_nothing;
+                        if(!p.buf_){
+                            p.bf_.next_buffer_size(1);
+                            cbuffer* b = co_await p.bs_;
+                            if(!b)
+                                break;
+                            p.buf_ = std::move(*b);
+                        }
+                        remaining_items = 1;
+                    }
+                }while(remaining_items);
+            }(ex_,*this,persistent,mark_ends);
         }
 
-        Executor get_executor() const noexcept
+        template<typename T>
+        auto get() [[clang::lifetimebound]]
         {
-            return ex_;
+            return detail::parser_read_awaitable<parser,T>{*this};
         }
 
-        void set_initial(cbuffer buf) noexcept
+        auto get_length(uint8_t power) [[clang::lifetimebound]]
         {
-            buf_ = std::move(buf);
+            return detail::parser_read_awaitable<parser,uint32_t>{*this,power};
         }
 
-        cbuffer rest() noexcept
+        template<typename T>
+        auto read_slow(uint8_t power) [[clang::lifetimebound]]
         {
-            return std::move(buf_);
+            return [](Executor,parser& p,uint8_t power) -> subcoroutine<T,Executor> {
+                size_t n = size_t(1)<<power;
+                char merge_buf[max_msgpack_fixed_buffer_length];
+                size_t c,i = p.buf_.size();
+                cbuffer* b;
+                if(i)
+                    std::memcpy(merge_buf,p.buf_.data(),i);
+                do{
+                    size_t left = n-i;
+                    p.bf_.next_buffer_size(left);
+                    b = co_await p.bs_;
+                    if(!b)
+                        throw parser_error{parser_error::reason_t::unexpected_end};
+                    c = std::min(left,b->size());
+                    std::memcpy(merge_buf+i,b->data(),c);
+                    i += c;
+                }while(i<n);
+                if(c<b->size())
+                    p.buf_ = {std::move(*b),c};
+                else
+                    p.buf_ = {};
+                auto d = reinterpret_cast<const byte*>(merge_buf);
+                co_return n==sizeof(T)?detail::load_big_endian<T>(d):T(detail::load_length(d,power));
+            }(ex_,*this,power);
+        }
+    };
+
+    // Hands out events of batches yielded by a generator like parser::batched() one by one,
+    // only resuming the generator once a batch is exhausted. Batches must not be empty.
+    template<async_generator_yielding<span<event>> Generator>
+    class batched_event_source
+    {
+        class awaiter
+        {
+        public:
+            awaiter(batched_event_source& s) noexcept
+                : s_{s}
+            {}
+
+            bool await_ready()
+            {
+                if(!s_.pending_.empty())
+                    return true;
+                a_.emplace(get_awaiter(s_.gen_));
+                return a_->await_ready();
+            }
+
+            template<typename Promise>
+            auto await_suspend(stdcoro::coroutine_handle<Promise> handle)
+            {
+                return a_->await_suspend(handle);
+            }
+
+            event* await_resume()
+            {
+                if(a_){
+                    span<event>* batch = a_->await_resume();
+                    if(!batch)
+                        return nullptr;
+                    s_.pending_ = *batch;
+                }
+                event* e = s_.pending_.data();
+                s_.pending_ = s_.pending_.subspan(1);
+                return e;
+            }
+        private:
+            batched_event_source& s_;
+            optional<awaiter_type_t<Generator&>> a_;
+        };
+    public:
+        explicit batched_event_source(Generator& gen) noexcept
+            : gen_{gen}
+        {}
+
+        awaiter operator co_await() noexcept
+        {
+            return {*this};
         }
     private:
-        BufferSource& bs_;
-        BufferFactory& bf_;
-        parser_options options_;
-        Executor ex_;
-        cbuffer buf_;
+        Generator& gen_;
+        span<event> pending_;
+    };
 
-        template<typename T>
-        auto get() [[clang::lifetimebound]]
+    template<typename Generator>
+    struct is_asymmetric_awaitable<batched_event_source<Generator>>
+        : is_asymmetric_awaitable<awaiter_type_t<Generator&>> {};
+
+    // Hands out events of an event generator of parser, like consecutive(), and lets sinks
+    // step over values they don't need with parser::skip_value() instead of receiving them.
+    // Once the generator has finished, awaiting more events throws unexpected_end
+    // without resuming it, as sinks only await events they expect. Keeps track of where
+    // the current top-level object ends, so that the rest of it can be dropped
+    // after its consumer has given up on it.
+    template<typename Parser,async_generator_yielding<event> Generator>
+    class parser_event_source
+    {
+        class awaiter
         {
-            return [](Executor,parser& p) -> subcoroutine<T,Executor> {
-                constexpr size_t n = sizeof(T);
-                const void* d;
-                char merge_buf[max_msgpack_fixed_buffer_length];
-                if(p.buf_.size()>=sizeof(T)){
-                    d = p.buf_.data();
-                    p.buf_ = {p.buf_,n};
-                }else{
-                    size_t c,i = p.buf_.size();
-                    cbuffer* b;
-                    if(i)
-                        std::memcpy(merge_buf,p.buf_.data(),i);
-                    do{
-                        size_t left = n-i;
-                        p.bf_.next_buffer_size(left);
-                        b = co_await p.bs_;
-                        if(!b)
-                            throw parser_error{parser_error::reason_t::unexpected_end};
-                        c = std::min(left,b->size());
-                        std::memcpy(merge_buf+i,b->data(),c);
-                        i += c;
-                    }while(i<n);
-                    if(c<b->size())
-                        p.buf_ = {std::move(*b),c};
-                    else
-                        p.buf_ = {};
-                    d = merge_buf;
+        public:
+            awaiter(parser_event_source& s) noexcept
+                : s_{s}
+            {}
+
+            bool await_ready()
+            {
+                if(!s_.gen_)
+                    return true;
+                a_.emplace(get_awaiter(s_.gen_));
+                return a_->await_ready();
+            }
+
+            auto await_suspend(auto&& handle)
+            {
+                return a_->await_suspend(std::forward<decltype(handle)>(handle));
+            }
+
+            event* await_resume()
+            {
+                event* e = a_?a_->await_resume():nullptr;
+                if(!e){
+                    if(!s_.gen_)
+                        throw parser_error{parser_error::reason_t::unexpected_end};
+                    return e;
                 }
-                co_return boost::endian::endian_load<T,n,boost::endian::order::big>(
-                    static_cast<const unsigned char*>(d));
-            }(ex_,*this);
+                s_.account(*e);
+                return e;
+            }
+        private:
+            parser_event_source& s_;
+            optional<awaiter_type_t<Generator&>> a_;
+        };
+    public:
+        parser_event_source(Parser& p,Generator& gen) noexcept
+            : p_{p},
+              gen_{gen}
+        {}
+
+        awaiter operator co_await() noexcept
+        {
+            return {*this};
         }
 
-        subcoroutine<uint32_t,Executor> get_length(uint8_t power) [[clang::lifetimebound]]
+        auto skip_value()
         {
-            return [](Executor,parser& p,uint8_t power) -> subcoroutine<uint32_t,Executor> {
-                if(!power)
-                    co_return co_await p.get<uint8_t>();
-                if(power==1)
-                    co_return co_await p.get<uint16_t>();
-                co_return co_await p.get<uint32_t>();
-            }(ex_,*this,power);
+            if(remaining_)
+                --remaining_;
+            return p_.skip_value();
+        }
+
+        // Whether events of the current top-level object are still to come.
+        bool inside_object() const noexcept
+        {
+            return remaining_;
+        }
+
+        // Forgets the current object, for use with a new generator.
+        void reset() noexcept
+        {
+            remaining_ = 0;
+            data_length_ = 0;
+        }
+    private:
+        Parser& p_;
+        Generator& gen_;
+        // Values of the current object not finished yet, and data left of the current one.
+        uint64_t remaining_ = 0;
+        uint32_t data_length_ = 0;
+
+        void account(const event& e) noexcept
+        {
+            if(!remaining_)
+                remaining_ = 1;
+            if(auto data = e.get_if<cbuffer>()){
+                data_length_ -= uint32_t(data->size());
+                if(!data_length_)
+                    --remaining_;
+                return;
+            }
+            uint64_t items = 0;
+            switch(e.kind()){
+                case object_kind::map:
+                    items = uint64_t(e.get_if<map_header>()->size)*2;
+                    break;
+                case object_kind::sequence:
+                    items = e.get_if<sequence_header>()->size;
+                    break;
+                case object_kind::binary:
+                    data_length_ = e.get_if<binary_header>()->size;
+                    break;
+                case object_kind::extension:
+                    data_length_ = e.get_if<extension_header>()->size;
+                    break;
+                case object_kind::string:
+                    data_length_ = e.get_if<string_header>()->size;
+                    break;
+                default:
+                    break;
+            }
+            if(!data_length_)
+                remaining_ += items-1;
         }
     };
+
+    template<typename Parser,typename Generator>
+    struct is_asymmetric_awaitable<parser_event_source<Parser,Generator>>
+        : is_asymmetric_awaitable<awaiter_type_t<Generator&>> {};
 }
 
 #endif
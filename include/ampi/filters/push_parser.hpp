@@ -0,0 +1,169 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_D2B6E0A8_41C7_4F3E_8A9D_6C5E13F7B024
+#define UUID_D2B6E0A8_41C7_4F3E_8A9D_6C5E13F7B024
+
+#include <ampi/filters/parser.hpp>
+
+namespace ampi
+{
+    // Resumable parser that is fed buffers as they arrive instead of awaiting them.
+    // It produces the same events as parser, keeping all state between calls to feed()
+    // in the object itself, without any coroutine frames.
+    class push_parser
+    {
+    public:
+        explicit push_parser(parser_options options = {}) noexcept
+            : options_{options}
+        {}
+
+        // Passes all events that can be parsed from buf to vis. Returns the number of bytes
+        // that are at least needed to continue, or 0 if the top-level object is complete,
+        // in which case bytes of buf after it are kept as rest().
+        template<event_visitor Visitor>
+        size_t feed(cbuffer buf,Visitor&& vis)
+        {
+            while(remaining_items_){
+                if(data_length_){
+                    if(!buf)
+                        return data_length_;
+                    size_t c = std::min<size_t>(data_length_,buf.size());
+                    cbuffer data{buf,0,c};
+                    buf = {std::move(buf),c};
+                    if(check_utf8_&&u8v_({reinterpret_cast<const char*>(data.data()),data.size()}))
+                        throw parser_error{parser_error::reason_t::invalid_utf8};
+                    data_length_ -= uint32_t(c);
+                    if(!data_length_){
+                        if(check_utf8_&&!u8v_)
+                            throw parser_error{parser_error::reason_t::invalid_utf8};
+                        --remaining_items_;
+                    }
+                    vis(event{std::move(data)});
+                    continue;
+                }
+                detail::decoded_header h;
+                size_t n;
+                if(!header_length_&&buf&&
+                        (n = detail::header_size(buf.data(),buf.size()))<=buf.size()){
+                    h = detail::decode_header(buf.data());
+                    buf = {std::move(buf),n};
+                }else{
+                    for(n=header_length_?detail::header_size(header_,header_length_):1;
+                            header_length_<n;n=detail::header_size(header_,header_length_)){
+                        if(!buf)
+                            return n-header_length_;
+                        size_t c = std::min(n-header_length_,buf.size());
+                        std::memcpy(header_+header_length_,buf.data(),c);
+                        buf = {std::move(buf),c};
+                        header_length_ += uint8_t(c);
+                    }
+                    header_length_ = 0;
+                    h = detail::decode_header(header_);
+                }
+                remaining_items_ += h.items;
+                data_length_ = h.data_length;
+                if(data_length_){
+                    check_utf8_ = h.string&&!(options_&parser_option::skip_utf8_validation);
+                    u8v_.reset();
+                }else
+                    --remaining_items_;
+                vis(std::move(h.e));
+            }
+            rest_ = std::move(buf);
+            return 0;
+        }
+
+        bool done() const noexcept
+        {
+            return !remaining_items_;
+        }
+
+        cbuffer rest() noexcept
+        {
+            return std::move(rest_);
+        }
+
+        // Prepares for parsing the next top-level object.
+        void reset() noexcept
+        {
+            remaining_items_ = 1;
+            data_length_ = 0;
+            header_length_ = 0;
+        }
+    private:
+        uint64_t remaining_items_ = 1;
+        uint32_t data_length_ = 0;
+        parser_options options_;
+        bool check_utf8_ = false;
+        utf8_validator u8v_;
+        uint8_t header_length_ = 0;
+        byte header_[detail::max_msgpack_header_length];
+        cbuffer rest_;
+    };
+
+    // Event source that lets existing sinks consume events of push_parser: pass it
+    // to feed() as a visitor, and the sink awaiting it is resumed inline for every event.
+    // A sink that is still waiting on destruction is resumed with nullptr to finish with an error.
+    class push_event_source
+    {
+        class awaiter
+        {
+        public:
+            awaiter(push_event_source& s) noexcept
+                : s_{s}
+            {}
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(stdcoro::coroutine_handle<> handle) noexcept
+            {
+                s_.handle_ = handle;
+            }
+
+            event* await_resume() noexcept
+            {
+                return std::exchange(s_.current_,nullptr);
+            }
+        private:
+            push_event_source& s_;
+        };
+    public:
+        push_event_source() = default;
+        push_event_source(const push_event_source&) = delete;
+        push_event_source& operator=(const push_event_source&) = delete;
+
+        ~push_event_source()
+        {
+            if(handle_)
+                std::exchange(handle_,{}).resume();
+        }
+
+        // Events arriving when no sink is waiting, e.g. after it has failed, are dropped.
+        void operator()(event e)
+        {
+            if(!handle_)
+                return;
+            e_ = std::move(e);
+            current_ = &e_;
+            std::exchange(handle_,{}).resume();
+        }
+
+        awaiter operator co_await() noexcept
+        {
+            return {*this};
+        }
+    private:
+        stdcoro::coroutine_handle<> handle_;
+        event e_;
+        event* current_ = nullptr;
+    };
+}
+
+#endif
@@ -0,0 +1,111 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_7C1E94A2_5B3F_4D08_A6E1_2F9B8C0D4E57
+#define UUID_7C1E94A2_5B3F_4D08_A6E1_2F9B8C0D4E57
+
+#include <ampi/filters/parser.hpp>
+
+namespace ampi
+{
+    // Parses one top-level object from a contiguous buffer into the same events as parser,
+    // but as a plain loop without coroutines. Events are either pulled with next(),
+    // pushed into a visitor or awaited by event sinks, for which this is an event_source.
+    // Data events share ownership of the input buffer.
+    class span_parser
+    {
+    public:
+        explicit span_parser(cbuffer buf,parser_options options = {}) noexcept
+            : buf_{std::move(buf)},
+              options_{options}
+        {}
+
+        // Returns nullptr once the top-level object has been parsed.
+        event* next()
+        {
+            if(data_length_){
+                size_t n = std::exchange(data_length_,0);
+                if(buf_.size()-pos_<n)
+                    throw parser_error{parser_error::reason_t::unexpected_end};
+                if(string_data_&&!(options_&parser_option::skip_utf8_validation)&&
+                        utf8_validator::validate({reinterpret_cast<const char*>(buf_.data()+pos_),n}))
+                    throw parser_error{parser_error::reason_t::invalid_utf8};
+                e_ = cbuffer{buf_,pos_,n};
+                pos_ += n;
+                return &e_;
+            }
+            if(!remaining_items_)
+                return nullptr;
+            const byte* p = buf_.data()+pos_;
+            size_t avail = buf_.size()-pos_,
+                   n = avail?detail::header_size(p,avail):1;
+            if(n>avail)
+                throw parser_error{parser_error::reason_t::unexpected_end};
+            auto h = detail::decode_header(p);
+            pos_ += n;
+            remaining_items_ += h.items-1;
+            data_length_ = h.data_length;
+            string_data_ = h.string;
+            e_ = std::move(h.e);
+            return &e_;
+        }
+
+        // Skips the next value, counting nested headers and stepping over data
+        // without producing events or validating UTF-8 of skipped strings.
+        void skip_value()
+        {
+            assert(remaining_items_&&!data_length_);
+            pos_ += detail::encoded_value_size(buf_.view().subspan(pos_));
+            --remaining_items_;
+        }
+
+        template<event_visitor Visitor>
+        void operator()(Visitor&& vis)
+        {
+            while(event* e = next())
+                vis(std::move(*e));
+        }
+
+        auto operator co_await() noexcept
+        {
+            struct awaiter
+            {
+                span_parser& p;
+
+                bool await_ready() const noexcept
+                {
+                    return true;
+                }
+
+                void await_suspend(stdcoro::coroutine_handle<>) const noexcept {}
+
+                event* await_resume() const
+                {
+                    return p.next();
+                }
+            };
+            return awaiter{*this};
+        }
+
+        cbuffer rest() noexcept
+        {
+            return {std::move(buf_),std::exchange(pos_,0)};
+        }
+    private:
+        cbuffer buf_;
+        size_t pos_ = 0;
+        uint64_t remaining_items_ = 1;
+        size_t data_length_ = 0;
+        parser_options options_;
+        bool string_data_ = false;
+        event e_;
+    };
+
+    template<>
+    struct is_asymmetric_awaitable<span_parser> : std::true_type {};
+}
+
+#endif
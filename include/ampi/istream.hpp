@@ -30,9 +30,18 @@ namespace ampi
             requires (!std::is_const_v<T>)
         istream_msgpack_ctx& operator>>(T& x)
         {
-            auto p_v = this->p_();
-            auto sink = serial_event_sink(type_tag<T>)(ctx_.ex,p_v,x).assume_blocking();
-            sink();
+            try{
+                if(start_object()){
+                    auto skipper = skip_rest().assume_blocking();
+                    skipper();
+                }
+                auto sink = serial_event_sink(type_tag<T>)(ctx_.ex,source_,x).assume_blocking();
+                sink();
+            }
+            catch(const parser_error&){
+                parser_failed();
+                throw;
+            }
             return *this;
         }
     };
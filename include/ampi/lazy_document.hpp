@@ -0,0 +1,278 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_9A4F2C61_E7B3_4D85_B0C9_58E2A1D6F374
+#define UUID_9A4F2C61_E7B3_4D85_B0C9_58E2A1D6F374
+
+#include <ampi/event_sinks/event_sink.hpp>
+#include <ampi/filters/span_parser.hpp>
+
+#include <algorithm>
+#include <utility>
+
+namespace ampi
+{
+    class lazy_document;
+
+    // A value inside a lazy_document, referred to by the offset of its encoding.
+    class lazy_value
+    {
+    public:
+        object_kind kind() const
+        {
+            return header().first.e.kind();
+        }
+
+        // Number of elements for maps and sequences, length of data for strings,
+        // binaries and extensions, 0 otherwise.
+        uint32_t size() const
+        {
+            auto h = header().first;
+            return h.items?uint32_t(h.items>>(h.e.kind()==object_kind::map)):h.data_length;
+        }
+
+        optional<lazy_value> find(string_view key) const;
+
+        lazy_value operator[](string_view key) const
+        {
+            if(auto v = find(key))
+                return *v;
+            throw structure_error{structure_error::reason_t::out_of_range,
+                                  boost::typeindex::type_id<lazy_document>(),{object_kind::map}};
+        }
+
+        lazy_value operator[](uint32_t i) const;
+
+        // Encoded value, sharing ownership with the document buffer.
+        cbuffer raw() const;
+
+        // Data of strings, binaries and extensions, sharing ownership with the document buffer.
+        cbuffer data() const;
+
+        // Besides deserializable types, string_view and cbuffer give data without copying.
+        template<typename T>
+            requires deserializable<T>||std::same_as<T,string_view>||std::same_as<T,cbuffer>
+        T as() const
+        {
+            if constexpr(std::is_same_v<T,string_view>){
+                auto h = header().first;
+                expect_kind(h,object_kind::string);
+                cbuffer d = data();
+                return {reinterpret_cast<const char*>(d.data()),d.size()};
+            }else if constexpr(std::is_same_v<T,cbuffer>)
+                return data();
+            else{
+                T x;
+                if constexpr(serial_event_sink_ns::scalar_deserializable<T>){
+                    auto h = header().first;
+                    serial_event_sink_ns::assign_scalar(&h.e,x);
+                }else{
+                    span_parser sp{raw(),options()};
+                    detail::stack_executor_ctx ctx;
+                    auto sink = serial_event_sink(type_tag<T>)(ctx.ex,sp,x).assume_blocking();
+                    sink();
+                }
+                return x;
+            }
+        }
+    private:
+        friend class lazy_document;
+
+        const lazy_document* doc_;
+        size_t offset_;
+
+        lazy_value(const lazy_document& doc,size_t offset) noexcept
+            : doc_{&doc},
+              offset_{offset}
+        {}
+
+        parser_options options() const noexcept;
+        std::pair<detail::decoded_header,size_t> header() const;
+
+        static void expect_kind(detail::decoded_header& h,object_kind kind)
+        {
+            if(h.e.kind()!=kind)
+                throw structure_error{structure_error::reason_t::unexpected_event,
+                                      boost::typeindex::type_id<lazy_document>(),
+                                      {kind},std::move(h.e)};
+        }
+    };
+
+    // Read-only access to a MessagePack object that decodes and checks only the parts
+    // that are asked for. Strings and data are not copied, keys of visited maps and offsets
+    // of visited sequence elements are indexed on first lookup. As lookups update the index, a document may only be used
+    // by one thread at a time, and as values refer to it, it can't be copied or moved.
+    class lazy_document
+    {
+    public:
+        // Only the header of the root is checked here, errors in the rest of buf
+        // are reported by accesses that reach them.
+        explicit lazy_document(cbuffer buf,parser_options options = {})
+            : buf_{std::move(buf)},
+              options_{options}
+        {
+            root().header();
+        }
+
+        lazy_document(const lazy_document&) = delete;
+        lazy_document& operator=(const lazy_document&) = delete;
+
+        lazy_value root() const noexcept
+        {
+            return {*this,0};
+        }
+
+        optional<lazy_value> find(string_view key) const
+        {
+            return root().find(key);
+        }
+
+        lazy_value operator[](string_view key) const
+        {
+            return root()[key];
+        }
+
+        lazy_value operator[](uint32_t i) const
+        {
+            return root()[i];
+        }
+
+        template<typename T>
+        T as() const
+        {
+            return root().as<T>();
+        }
+
+        const cbuffer& buffer() const noexcept
+        {
+            return buf_;
+        }
+    private:
+        friend class lazy_value;
+
+        struct map_index
+        {
+            size_t offset;
+            // Keys and offsets of values for the first scanned entries.
+            vector<std::pair<string_view,size_t>> entries;
+            uint32_t scanned = 0;
+            size_t next_offset;
+        };
+
+        struct sequence_index
+        {
+            size_t offset;
+            // Offsets of the first scanned elements.
+            vector<size_t> elements;
+        };
+
+        cbuffer buf_;
+        parser_options options_;
+        // Filled by const lookups, see class comment.
+        mutable vector<map_index> maps_;
+        mutable vector<sequence_index> sequences_;
+
+        size_t value_size(size_t offset) const
+        {
+            return detail::encoded_value_size(buf_.view().subspan(offset));
+        }
+    };
+
+    inline parser_options lazy_value::options() const noexcept
+    {
+        return doc_->options_;
+    }
+
+    inline std::pair<detail::decoded_header,size_t> lazy_value::header() const
+    {
+        // Offsets always point inside the buffer, past values checked with encoded_value_size.
+        const byte* p = doc_->buf_.data()+offset_;
+        size_t avail = doc_->buf_.size()-offset_,
+               n = avail?detail::header_size(p,avail):1;
+        if(n>avail)
+            throw parser_error{parser_error::reason_t::unexpected_end};
+        return {detail::decode_header(p),n};
+    }
+
+    inline cbuffer lazy_value::raw() const
+    {
+        return {doc_->buf_,offset_,doc_->value_size(offset_)};
+    }
+
+    inline cbuffer lazy_value::data() const
+    {
+        auto [h,n] = header();
+        if(h.e.kind()!=object_kind::binary&&h.e.kind()!=object_kind::extension)
+            expect_kind(h,object_kind::string);
+        if(doc_->buf_.size()-offset_-n<h.data_length)
+            throw parser_error{parser_error::reason_t::unexpected_end};
+        cbuffer d{doc_->buf_,offset_+n,h.data_length};
+        if(h.string&&!(options()&parser_option::skip_utf8_validation)&&
+                utf8_validator::validate({reinterpret_cast<const char*>(d.data()),d.size()}))
+            throw parser_error{parser_error::reason_t::invalid_utf8};
+        return d;
+    }
+
+    inline optional<lazy_value> lazy_value::find(string_view key) const
+    {
+        auto [h,n] = header();
+        expect_kind(h,object_kind::map);
+        auto& maps = doc_->maps_;
+        auto it = std::find_if(maps.begin(),maps.end(),[&](const lazy_document::map_index& mi){
+            return mi.offset==offset_;
+        });
+        if(it==maps.end()){
+            maps.push_back({offset_,{},0,offset_+n});
+            it = maps.end()-1;
+        }
+        for(auto& [k,o]:it->entries)
+            if(k==key)
+                return lazy_value{*doc_,o};
+        bool check_utf8 = !(options()&parser_option::skip_utf8_validation);
+        for(uint32_t size = uint32_t(h.items/2);it->scanned<size;){
+            lazy_value k{*doc_,it->next_offset};
+            size_t value_offset = k.offset_+doc_->value_size(k.offset_);
+            it->next_offset = value_offset+doc_->value_size(value_offset);
+            ++it->scanned;
+            auto [kh,kn] = k.header();
+            if(kh.e.kind()!=object_kind::string)
+                continue;
+            string_view ks{reinterpret_cast<const char*>(doc_->buf_.data()+k.offset_+kn),kh.data_length};
+            if(check_utf8&&utf8_validator::validate(ks))
+                throw parser_error{parser_error::reason_t::invalid_utf8};
+            it->entries.emplace_back(ks,value_offset);
+            if(ks==key)
+                return lazy_value{*doc_,value_offset};
+        }
+        return {};
+    }
+
+    inline lazy_value lazy_value::operator[](uint32_t i) const
+    {
+        auto [h,n] = header();
+        expect_kind(h,object_kind::sequence);
+        if(i>=h.items)
+            throw structure_error{structure_error::reason_t::out_of_range,
+                                  boost::typeindex::type_id<lazy_document>(),
+                                  {object_kind::sequence},std::move(h.e)};
+        auto& sequences = doc_->sequences_;
+        auto it = std::find_if(sequences.begin(),sequences.end(),
+            [&](const lazy_document::sequence_index& si){
+                return si.offset==offset_;
+            });
+        if(it==sequences.end()){
+            sequences.push_back({offset_,{}});
+            it = sequences.end()-1;
+            it->elements.push_back(offset_+n);
+        }
+        auto& elements = it->elements;
+        while(elements.size()<=i)
+            elements.push_back(elements.back()+doc_->value_size(elements.back()));
+        return {*doc_,elements[i]};
+    }
+}
+
+#endif
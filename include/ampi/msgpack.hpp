@@ -8,13 +8,14 @@
 #define UUID_6012704F_D6C6_4442_AC01_724C0376DC68
 
 #include <ampi/buffer_sinks/container_buffer_sink.hpp>
-#include <ampi/buffer_sources/one_buffer_source.hpp>
 #include <ampi/detail/fixed_msgpack_buffer_factory.hpp>
 #include <ampi/detail/msgunpack_ctx_base.hpp>
+#include <ampi/direct_decoders/direct_decoder.hpp>
+#include <ampi/direct_encoders/direct_encoder.hpp>
 #include <ampi/event_sinks/event_sink.hpp>
 #include <ampi/event_sources/event_source.hpp>
 #include <ampi/filters/emitter.hpp>
-#include <ampi/filters/parser.hpp>
+#include <ampi/filters/span_parser.hpp>
 
 namespace ampi
 {
@@ -25,14 +26,30 @@ namespace ampi
     public:
         using msgunpack_ctx_base::msgunpack_ctx_base;
 
-        template<serializable T>
-        void msgpack(auto& cont,const T& x)
+        // Appends the encoding of x to a container. Contiguous resizable containers of bytes
+        // are written in place, growing at most once for types with direct encoders
+        // and geometrically otherwise. Other containers get pieces of the encoding inserted.
+        template<serializable T,typename Container>
+        void msgpack(Container& cont,const T& x)
         {
-            auto ses = serial_event_source(type_tag<T>)(ctx_.ex,x);
-            detail::fixed_msgpack_buffer_factory bf;
-            auto em = emitter(ctx_.ex,ses,bf);
-            auto sink = container_buffer_sink(ctx_.ex,cont,em).assume_blocking();
-            sink();
+            if constexpr(!detail::resizable_byte_container<Container>){
+                auto ses = serial_event_source(type_tag<T>)(ctx_.ex,x);
+                detail::fixed_msgpack_buffer_factory bf;
+                auto em = emitter(ctx_.ex,ses,bf);
+                auto sink = container_buffer_sink(ctx_.ex,cont,em).assume_blocking();
+                sink();
+            }else if constexpr(direct_encodable<T>){
+                size_t size = std::size(cont);
+                detail::resize_for_writing(cont,size+msgpack_size(x));
+                byte* p = reinterpret_cast<byte*>(std::data(cont))+size;
+                encode([&](size_t n){
+                    return std::exchange(p,p+n);
+                },x);
+            }else{
+                detail::container_writer<Container> cw{cont};
+                encode(cw,x);
+                cw.finish();
+            }
         }
 
         template<typename Container = vector<byte>>
@@ -43,15 +60,36 @@ namespace ampi
             return cont;
         }
 
+        // Encodes x into out, returning the length of its encoding. If that is greater
+        // than out.size(), only what fits has been written.
+        template<serializable T>
+        size_t msgpack_to(binary_view_t out,const T& x)
+        {
+            detail::span_writer sw{out};
+            encode(sw,x);
+            return sw.size;
+        }
+
+        // Length of the encoding of x, without producing it.
+        template<serializable T>
+        size_t msgpack_size(const T& x)
+        {
+            detail::size_counter sc;
+            encode(sc,x);
+            return sc.size;
+        }
+
         template<deserializable T>
         void msgunpack(T& x,binary_cview_t view)
         {
-            auto obs = one_buffer_source(ctx_.ex,view);
-            null_buffer_factory bf;
-            parser p{obs,bf,po_,ctx_.ex};
-            auto p_v = p();
-            auto sink = serial_event_sink(type_tag<T>)(ctx_.ex,p_v,x).assume_blocking();
-            sink();
+            if constexpr(direct_decodable<T>){
+                direct_reader r{view,po_};
+                direct_decoder(type_tag<T>)(r,x);
+            }else{
+                span_parser sp{view,po_};
+                auto sink = serial_event_sink(type_tag<T>)(ctx_.ex,sp,x).assume_blocking();
+                sink();
+            }
         }
 
         template<typename T = value>
@@ -61,6 +99,18 @@ namespace ampi
             msgunpack(x,view);
             return x;
         }
+    private:
+        template<serializable T>
+        void encode(auto&& alloc,const T& x)
+        {
+            if constexpr(direct_encodable<T>)
+                direct_encoder(type_tag<T>)(x,alloc);
+            else{
+                auto ses = serial_event_source(type_tag<T>)(ctx_.ex,x);
+                auto em = alloc_emitter(ctx_.ex,ses,alloc).assume_blocking();
+                em();
+            }
+        }
     };
 
     template<serializable T>
@@ -75,6 +125,18 @@ namespace ampi
         return msgpack_ctx{}.msgpack<Container>(x);
     }
 
+    template<serializable T>
+    size_t msgpack_to(binary_view_t out,const T& x)
+    {
+        return msgpack_ctx{}.msgpack_to(out,x);
+    }
+
+    template<serializable T>
+    size_t msgpack_size(const T& x)
+    {
+        return msgpack_ctx{}.msgpack_size(x);
+    }
+
     template<deserializable T>
     void msgunpack(T& x,binary_cview_t view)
     {
@@ -0,0 +1,101 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef UUID_71FB8997_BD21_4B2F_8A2E_7F61FBE97E2E
+#define UUID_71FB8997_BD21_4B2F_8A2E_7F61FBE97E2E
+
+#include <ampi/export.h>
+#include <ampi/utils/stdtypes.hpp>
+
+#include <boost/container/pmr/global_resource.hpp>
+#include <boost/container/pmr/memory_resource.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+namespace ampi
+{
+    // Keeps deallocated blocks in free lists of power of two size classes
+    // from min_block_size to max_block_size for reuse, passing other requests to upstream.
+    // Allocation is only allowed on one thread, the first one that allocates.
+    // Blocks deallocated on that thread go to its free lists directly, those deallocated
+    // on other threads are pushed to lock-free lists taken over when its own lists run empty.
+    class AMPI_EXPORT buffer_pool_resource final : public boost::container::pmr::memory_resource
+    {
+    public:
+        constexpr static size_t min_block_size = 0x1000,
+                                max_block_size = 0x1000000;
+
+        // Only meaningful on the allocating thread.
+        struct statistics
+        {
+            uint64_t hits = 0,misses = 0;
+        };
+
+        explicit buffer_pool_resource(boost::container::pmr::memory_resource* upstream =
+                boost::container::pmr::get_default_resource()) noexcept
+            : upstream_{upstream}
+        {}
+
+        buffer_pool_resource(const buffer_pool_resource&) = delete;
+        buffer_pool_resource& operator=(const buffer_pool_resource&) = delete;
+
+        ~buffer_pool_resource() override;
+
+        // Size of the block that serves an allocation of n bytes, if it is pooled.
+        constexpr static size_t block_size(size_t n) noexcept
+        {
+            return std::bit_ceil(std::max(n,min_block_size));
+        }
+
+        boost::container::pmr::memory_resource* upstream() const noexcept
+        {
+            return upstream_;
+        }
+
+        statistics stats() const noexcept
+        {
+            return stats_;
+        }
+
+        // Returns all free blocks to upstream. Only allowed on the allocating thread.
+        void release() noexcept;
+    protected:
+        void* do_allocate(size_t bytes,size_t alignment) override;
+        void do_deallocate(void* p,size_t bytes,size_t alignment) override;
+        bool do_is_equal(const boost::container::pmr::memory_resource& other) const noexcept override;
+    private:
+        struct free_block
+        {
+            free_block* next;
+        };
+
+        constexpr static size_t min_block_size_log2 = std::bit_width(min_block_size)-1,
+                                size_classes = std::bit_width(max_block_size)-min_block_size_log2;
+
+        boost::container::pmr::memory_resource* upstream_;
+        std::atomic<std::thread::id> owner_;
+        free_block* local_[size_classes] = {};
+        std::atomic<free_block*> remote_[size_classes] = {};
+        statistics stats_;
+
+        constexpr static bool is_pooled(size_t bytes,size_t alignment) noexcept
+        {
+            return bytes<=max_block_size&&alignment<=alignof(std::max_align_t);
+        }
+
+        constexpr static size_t size_class(size_t bytes) noexcept
+        {
+            return std::bit_width(std::max(bytes,min_block_size)-1)-min_block_size_log2;
+        }
+    };
+}
+
+#endif
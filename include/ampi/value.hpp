@@ -8,6 +8,7 @@
 #define UUID_3E6FEBBC_9311_4E08_B97B_7F7D2835D2B5
 
 #include <ampi/export.h>
+#include <ampi/direct_encoders/direct_encoder.hpp>
 #include <ampi/event_sinks/event_sink.hpp>
 #include <ampi/event_sources/event_source.hpp>
 #include <ampi/hash/flat_map.hpp>
@@ -15,6 +16,7 @@
 #include <ampi/hash/vector.hpp>
 
 #include <functional>
+#include <memory>
 #include <type_traits>
 #include <utility>
 
@@ -75,6 +77,8 @@ namespace ampi
         {
             async_event_consumer operator()(pmr_system_executor ex,event_source auto& source,value& v) const;
         };
+
+        void encode_value(const value& v,auto&& alloc);
     }
 
     class AMPI_EXPORT value
@@ -84,11 +88,44 @@ namespace ampi
         friend detail::value_se_source;
         friend detail::value_se_sink;
 
-        variant<std::nullptr_t,bool,uint64_t,int64_t,float,double,map,sequence,
-                piecewise_data,extension,piecewise_string,timestamp_t> v_;
+        struct cached_node;
+
+        // A subtree whose encoding is cached is moved into a node shared with that encoding,
+        // so that values without a cached encoding don't pay for it in size.
+        using cached_value = std::shared_ptr<cached_node>;
+
+        using variant_t = variant<std::nullptr_t,bool,uint64_t,int64_t,float,double,map,sequence,
+                                  piecewise_data,extension,piecewise_string,timestamp_t,cached_value>;
+
+        struct cached_node
+        {
+            variant_t v;
+            cbuffer encoded;
+        };
+
+        variant_t v_;
 
         template<typename T>
-        constexpr static bool is_value_type_v = boost::mp11::mp_contains<decltype(v_),T>{};
+        constexpr static bool is_value_type_v = boost::mp11::mp_contains<variant_t,T>{}&&
+                                                !std::is_same_v<T,cached_value>;
+
+        // The subtree, whether its encoding is cached or not.
+        const variant_t& plain() const noexcept
+        {
+            auto cv = ampi::get_if<cached_value>(&v_);
+            return cv?(*cv)->v:v_;
+        }
+
+        void drop_cached_encoding()
+        {
+            if(auto cv = ampi::get_if<cached_value>(&v_)){
+                auto node = std::move(*cv);
+                if(node.use_count()==1)
+                    v_ = std::move(node->v);
+                else
+                    v_ = node->v;
+            }
+        }
     public:
         value(std::nullptr_t = {}) noexcept
         {}
@@ -145,36 +182,56 @@ namespace ampi
 
         object_kind kind() const noexcept
         {
-            return object_kind(v_.index());
+            return object_kind(plain().index());
         }
 
         template<typename T>
             requires is_value_type_v<T>
         const T* get_if() const
         {
-            return ampi::get_if<T>(&v_);
+            return ampi::get_if<T>(&plain());
         }
 
+        // Drops the cached encoding, if there is one, as the result may be used to modify
+        // the value. Without one, this doesn't write to the value, so it is as safe
+        // to call concurrently as the const overload.
         template<typename T>
             requires is_value_type_v<T>
         T* get_if()
         {
+            drop_cached_encoding();
             return ampi::get_if<T>(&v_);
         }
 
+        // Stores the encoding of this value, which is then written as is instead of
+        // visiting its subtree, until it is modified through the non-const get_if or
+        // deserialized into. Nested values must not be modified through pointers
+        // obtained before this call. Copies of the value share the cached encoding.
+        // Only direct encoding, as by msgpack and msgpack_to, copies it in one piece. Events
+        // can't carry encoded bytes, so paths packing events, like async_msgpack, encoded_message
+        // and as_msgpack, get events parsed back from it and encode them again.
+        void cache_encoding();
+
+        const cbuffer* cached_encoding() const noexcept
+        {
+            auto cv = ampi::get_if<cached_value>(&v_);
+            return cv?&(*cv)->encoded:nullptr;
+        }
+
         friend bool operator==(const value& v1,const value& v2) noexcept
         {
-            return detail::variant_equal(v1.v_,v2.v_);
+            return detail::variant_equal(v1.plain(),v2.plain());
         }
 
         friend std::strong_ordering operator<=>(const value& v1,const value& v2) noexcept
         {
-            return detail::variant_three_way<detail::value_variant_three_way_t>(v1.v_,v2.v_);
+            return detail::variant_three_way<detail::value_variant_three_way_t>(v1.plain(),
+                                                                               v2.plain());
         }
 
         friend size_t hash_value(const value& v) noexcept
         {
-            return hash_value(v.v_);
+            return hash_value(v.plain());
         }
 
         friend AMPI_EXPORT std::ostream& operator<<(std::ostream& stream,const value& v);
@@ -188,13 +245,97 @@ namespace ampi
         {
             return detail::value_se_sink{};
         }
+
+        friend auto tag_invoke(tag_t<direct_encoder>,type_tag_t<value>) noexcept
+        {
+            return [](const value& v,auto&& alloc){
+                detail::encode_value(v,alloc);
+            };
+        }
     };
 
     namespace detail
     {
+        void encode_value(const value& v,auto&& alloc)
+        {
+            if(auto c = v.cached_encoding()){
+                encode_data(c->data(),c->size(),alloc);
+                return;
+            }
+            switch(v.kind()){
+                case object_kind::null:
+                    encode_null(alloc);
+                    break;
+                case object_kind::bool_:
+                    encode_bool(*v.get_if<bool>(),alloc);
+                    break;
+                case object_kind::unsigned_int:
+                    encode_unsigned(*v.get_if<uint64_t>(),alloc);
+                    break;
+                case object_kind::signed_int:
+                    encode_signed(*v.get_if<int64_t>(),alloc);
+                    break;
+                case object_kind::float_:
+                    encode_float(*v.get_if<float>(),alloc);
+                    break;
+                case object_kind::double_:
+                    encode_double(*v.get_if<double>(),alloc);
+                    break;
+                case object_kind::map:
+                    {
+                        auto& m = *v.get_if<map>();
+                        encode_container_header(true,serial_event_source_ns::check_size<map>(m.size()),alloc);
+                        for(auto& [k,mv]:m){
+                            encode_value(k,alloc);
+                            encode_value(mv,alloc);
+                        }
+                    }
+                    break;
+                case object_kind::sequence:
+                    {
+                        auto& s = *v.get_if<sequence>();
+                        encode_container_header(false,
+                            serial_event_source_ns::check_size<sequence>(s.size()),alloc);
+                        for(auto& e:s)
+                            encode_value(e,alloc);
+                    }
+                    break;
+                case object_kind::binary:
+                    {
+                        auto& pd = *v.get_if<piecewise_data>();
+                        encode_binary_header(serial_event_source_ns::check_size<piecewise_data>(pd.size()),alloc);
+                        for(auto p:pd)
+                            encode_data(p.data(),p.size(),alloc);
+                    }
+                    break;
+                case object_kind::extension:
+                    {
+                        auto& ext = *v.get_if<extension>();
+                        encode_extension_header({
+                            serial_event_source_ns::check_size<piecewise_data>(ext.data.size()),
+                            ext.type},alloc);
+                        for(auto p:ext.data)
+                            encode_data(p.data(),p.size(),alloc);
+                    }
+                    break;
+                case object_kind::string:
+                    {
+                        auto& ps = *v.get_if<piecewise_string>();
+                        encode_string_header(serial_event_source_ns::check_size<piecewise_string>(ps.size()),alloc);
+                        for(auto p:ps)
+                            encode_data(p.data(),p.size(),alloc);
+                    }
+                    break;
+                default: // case object_kind::timestamp:
+                    encode_timestamp(*v.get_if<timestamp_t>(),alloc);
+            }
+        }
+
         async_event_consumer value_se_sink::operator()(pmr_system_executor ex,
             event_source auto& source,value& v) const
         {
+            if(ampi::get_if<value::cached_value>(&v.v_))
+                v.v_.emplace<std::nullptr_t>();
             auto fer = serial_event_sink_ns::first_event_repeater(ex,source);
             event e = serial_event_sink_ns::expect_event<value>(co_await fer,
                 object_kind_set::any-object_kind::data_buffer);
@@ -0,0 +1,122 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#include <ampi/buffer_sources/mmap_buffer_source.hpp>
+
+#include <boost/system/system_error.hpp>
+
+#include <cassert>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ampi
+{
+    namespace
+    {
+        [[noreturn]] void throw_errno()
+        {
+            throw boost::system::system_error{errno,boost::system::system_category()};
+        }
+
+        // Owns a mapping of a file window preceded by an anonymous page, the end of which holds
+        // the buffer header. Other allocations, like those of copies, are passed to upstream.
+        class mapping_resource final : public boost::container::pmr::memory_resource
+        {
+        public:
+            mapping_resource(byte* p,size_t n) noexcept
+                : p_{p},
+                  n_{n}
+            {}
+
+            mapping_resource(const mapping_resource&) = delete;
+            mapping_resource& operator=(const mapping_resource&) = delete;
+
+            ~mapping_resource() override
+            {
+                ::munmap(p_,n_);
+            }
+        protected:
+            void* do_allocate(size_t bytes,size_t alignment) override
+            {
+                return upstream_->allocate(bytes,alignment);
+            }
+
+            void do_deallocate(void* p,size_t bytes,size_t alignment) override
+            {
+                if(p<p_||p>=p_+n_)
+                    upstream_->deallocate(p,bytes,alignment);
+            }
+
+            bool do_is_equal(const boost::container::pmr::memory_resource& other)
+                const noexcept override
+            {
+                return this==&other;
+            }
+        private:
+            byte* p_;
+            size_t n_;
+            boost::container::pmr::memory_resource* upstream_ =
+                boost::container::pmr::get_default_resource();
+        };
+    }
+
+    mapped_file::mapped_file(const std::filesystem::path& path)
+        : fd_{::open(path.c_str(),O_RDONLY|O_CLOEXEC)}
+    {
+        if(fd_<0)
+            throw_errno();
+        struct ::stat st;
+        if(::fstat(fd_,&st)){
+            int e = errno;
+            ::close(fd_);
+            throw boost::system::system_error{e,boost::system::system_category()};
+        }
+        size_ = size_t(st.st_size);
+    }
+
+    mapped_file::~mapped_file()
+    {
+        if(fd_>=0)
+            ::close(fd_);
+    }
+
+    size_t mapped_file::page_size() noexcept
+    {
+        static const size_t ps = size_t(::sysconf(_SC_PAGESIZE));
+        return ps;
+    }
+
+    cbuffer mapped_file::map(size_t offset,size_t n,bool sequential) const
+    {
+        assert(n&&n<=cbuffer::max_size&&offset%page_size()==0);
+        size_t ps = page_size();
+        void* region = ::mmap(nullptr,ps+n,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+        if(region==MAP_FAILED)
+            throw_errno();
+        byte* p = static_cast<byte*>(region)+ps;
+        if(::mmap(p,n,PROT_READ,MAP_PRIVATE|MAP_FIXED,fd_,::off_t(offset))==MAP_FAILED){
+            int e = errno;
+            ::munmap(region,ps+n);
+            throw boost::system::system_error{e,boost::system::system_category()};
+        }
+        // The advice only tunes readahead, so failing to give it is harmless and not reported.
+        if(sequential)
+            static_cast<void>(::madvise(p,n,MADV_SEQUENTIAL));
+        shared_polymorphic_allocator<> spa;
+        try{
+            spa = shared_polymorphic_allocator<>{std::in_place_type<mapping_resource>,
+                                                 static_cast<byte*>(region),ps+n};
+        }
+        catch(...){
+            ::munmap(region,ps+n);
+            throw;
+        }
+        return {::new (p-sizeof(detail::buffer_header)) detail::buffer_header{n,std::move(spa)}};
+    }
+}
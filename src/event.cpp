@@ -75,7 +75,7 @@ namespace ampi
 
     namespace
     {
-        struct event_visitor
+        struct event_printer
         {
             std::ostream& stream_;
 
@@ -111,7 +111,7 @@ namespace ampi
         stream << e.kind();
         if(e.kind()!=object_kind::null){
             stream << ':';
-            visit(event_visitor{stream},e.v_);
+            visit(event_printer{stream},e.v_);
         }
         return stream;
     }
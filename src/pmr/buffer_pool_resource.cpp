@@ -0,0 +1,79 @@
+// Copyright 2021 Pavel A. Lebedev
+// Licensed under the Apache License, Version 2.0.
+// (See accompanying file LICENSE.txt or copy at
+//  http://www.apache.org/licenses/LICENSE-2.0)
+// SPDX-License-Identifier: Apache-2.0
+
+#include <ampi/pmr/buffer_pool_resource.hpp>
+
+#include <cassert>
+#include <new>
+#include <utility>
+
+namespace ampi
+{
+    buffer_pool_resource::~buffer_pool_resource()
+    {
+        release();
+    }
+
+    void buffer_pool_resource::release() noexcept
+    {
+        for(size_t i=0;i<size_classes;++i){
+            free_block* b = std::exchange(local_[i],nullptr);
+            for(int j=0;j<2;++j){
+                while(b)
+                    upstream_->deallocate(std::exchange(b,b->next),min_block_size<<i,
+                                          alignof(std::max_align_t));
+                b = remote_[i].exchange(nullptr,std::memory_order_acquire);
+            }
+        }
+    }
+
+    void* buffer_pool_resource::do_allocate(size_t bytes,size_t alignment)
+    {
+        if(!is_pooled(bytes,alignment))
+            return upstream_->allocate(bytes,alignment);
+        auto id = std::this_thread::get_id();
+        if(owner_.load(std::memory_order_relaxed)==std::thread::id{})
+            owner_.store(id,std::memory_order_relaxed);
+        assert(owner_.load(std::memory_order_relaxed)==id);
+        size_t i = size_class(bytes);
+        free_block* b = local_[i];
+        if(!b)
+            // Taking the whole list at once leaves no room for ABA.
+            b = remote_[i].exchange(nullptr,std::memory_order_acquire);
+        if(b){
+            local_[i] = b->next;
+            ++stats_.hits;
+            return b;
+        }
+        local_[i] = nullptr;
+        ++stats_.misses;
+        return upstream_->allocate(min_block_size<<i,alignof(std::max_align_t));
+    }
+
+    void buffer_pool_resource::do_deallocate(void* p,size_t bytes,size_t alignment)
+    {
+        if(!is_pooled(bytes,alignment)){
+            upstream_->deallocate(p,bytes,alignment);
+            return;
+        }
+        size_t i = size_class(bytes);
+        auto b = ::new (p) free_block{};
+        if(std::this_thread::get_id()==owner_.load(std::memory_order_relaxed)){
+            b->next = local_[i];
+            local_[i] = b;
+        }else{
+            b->next = remote_[i].load(std::memory_order_relaxed);
+            while(!remote_[i].compare_exchange_weak(b->next,b,std::memory_order_release,
+                                                    std::memory_order_relaxed));
+        }
+    }
+
+    bool buffer_pool_resource::do_is_equal(const boost::container::pmr::memory_resource& other)
+        const noexcept
+    {
+        return this==&other;
+    }
+}
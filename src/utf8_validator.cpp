@@ -6,8 +6,213 @@
 
 #include <ampi/utf8_validator.hpp>
 
+#include <cstring>
+
+#if defined(__GNUC__)&&(defined(__x86_64__)||defined(__i386__))
+#define AMPI_UTF8_VALIDATOR_X86_SIMD
+#include <immintrin.h>
+#endif
+
 namespace ampi
 {
+    namespace
+    {
+        // If [begin,end) ends with an incomplete sequence, returns its start, otherwise end.
+        const char* complete_prefix_end(const char* begin,const char* end) noexcept
+        {
+            const char* q = end;
+            while(q!=begin&&end-q<3&&(uint8_t(q[-1])&0xc0)==0x80)
+                --q;
+            if(q==begin)
+                return end;
+            auto lead = uint8_t(q[-1]);
+            ptrdiff_t length = lead>=0xf0?4:lead>=0xe0?3:lead>=0xc0?2:1;
+            return end-(q-1)<length?q-1:end;
+        }
+
+#ifdef AMPI_UTF8_VALIDATOR_X86_SIMD
+        // Block validation from "Validating UTF-8 In Less Than One Instruction Per Byte"
+        // by J. Keiser and D. Lemire: 3 table lookups by nibbles of a byte and its predecessor
+        // classify errors in every pair of bytes, and lengths of 3- and 4-byte sequences are
+        // checked by leading bytes 2 and 3 positions back.
+        constexpr uint8_t too_short = 1<<0,
+                          too_long = 1<<1,
+                          overlong_3 = 1<<2,
+                          too_large = 1<<3,
+                          surrogate = 1<<4,
+                          overlong_2 = 1<<5,
+                          too_large_1000 = 1<<6,
+                          overlong_4 = 1<<6,
+                          two_conts = 1<<7,
+                          carry = too_short|too_long|two_conts;
+
+        alignas(16) constexpr uint8_t byte_1_high_table[16] = {
+            // 0_______ ________
+            too_long,too_long,too_long,too_long,too_long,too_long,too_long,too_long,
+            // 10______ ________
+            two_conts,two_conts,two_conts,two_conts,
+            // 1100____ ________
+            too_short|overlong_2,
+            // 1101____ ________
+            too_short,
+            // 1110____ ________
+            too_short|overlong_3|surrogate,
+            // 1111____ ________
+            too_short|too_large|too_large_1000|overlong_4
+        };
+
+        alignas(16) constexpr uint8_t byte_1_low_table[16] = {
+            // ____0000 ________
+            carry|overlong_3|overlong_2|overlong_4,
+            // ____0001 ________
+            carry|overlong_2,
+            // ____001_ ________
+            carry,
+            carry,
+            // ____0100 ________
+            carry|too_large,
+            // ____0101 ________ and above
+            carry|too_large|too_large_1000,
+            carry|too_large|too_large_1000,
+            carry|too_large|too_large_1000,
+            carry|too_large|too_large_1000,
+            carry|too_large|too_large_1000,
+            carry|too_large|too_large_1000,
+            carry|too_large|too_large_1000,
+            carry|too_large|too_large_1000,
+            // ____1101 ________
+            carry|too_large|too_large_1000|surrogate,
+            carry|too_large|too_large_1000,
+            carry|too_large|too_large_1000
+        };
+
+        alignas(16) constexpr uint8_t byte_2_high_table[16] = {
+            // ________ 0_______
+            too_short,too_short,too_short,too_short,too_short,too_short,too_short,too_short,
+            // ________ 1000____
+            too_long|overlong_2|two_conts|overlong_3|too_large_1000|overlong_4,
+            // ________ 1001____
+            too_long|overlong_2|two_conts|overlong_3|too_large,
+            // ________ 101_____
+            too_long|overlong_2|two_conts|surrogate|too_large,
+            too_long|overlong_2|two_conts|surrogate|too_large,
+            // ________ 11______
+            too_short,too_short,too_short,too_short
+        };
+
+        // Returns the end of the longest prefix of [p,e) made of whole blocks without errors,
+        // backed up to the start of an incomplete sequence at its end, if any.
+        // p must be at the start of a sequence.
+        [[gnu::target("sse4.1")]]
+        const char* validate_blocks_sse41(const char* p,const char* e) noexcept
+        {
+            const char* begin = p;
+            const __m128i byte_1_high = _mm_load_si128(reinterpret_cast<const __m128i*>(byte_1_high_table)),
+                          byte_1_low = _mm_load_si128(reinterpret_cast<const __m128i*>(byte_1_low_table)),
+                          byte_2_high = _mm_load_si128(reinterpret_cast<const __m128i*>(byte_2_high_table)),
+                          low_nibble = _mm_set1_epi8(0x0f),
+                          max_value = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+                                                    char(0xf0-1),char(0xe0-1),char(0xc0-1));
+            __m128i prev = _mm_setzero_si128(),
+                    prev_incomplete = _mm_setzero_si128();
+            for(;e-p>=16;p+=16){
+                __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)),
+                        error;
+                if(!_mm_movemask_epi8(input))
+                    // ASCII fast path, only sequences cut at the end of previous block are errors.
+                    error = prev_incomplete;
+                else{
+                    __m128i prev1 = _mm_alignr_epi8(input,prev,16-1),
+                            special_cases = _mm_and_si128(_mm_and_si128(
+                                _mm_shuffle_epi8(byte_1_high,_mm_and_si128(_mm_srli_epi16(prev1,4),low_nibble)),
+                                _mm_shuffle_epi8(byte_1_low,_mm_and_si128(prev1,low_nibble))),
+                                _mm_shuffle_epi8(byte_2_high,_mm_and_si128(_mm_srli_epi16(input,4),low_nibble))),
+                            must_be_continuation = _mm_or_si128(
+                                _mm_subs_epu8(_mm_alignr_epi8(input,prev,16-2),_mm_set1_epi8(char(0xe0-0x80))),
+                                _mm_subs_epu8(_mm_alignr_epi8(input,prev,16-3),_mm_set1_epi8(char(0xf0-0x80))));
+                    error = _mm_xor_si128(_mm_and_si128(must_be_continuation,_mm_set1_epi8(char(0x80))),
+                                          special_cases);
+                    prev_incomplete = _mm_subs_epu8(input,max_value);
+                }
+                if(!_mm_testz_si128(error,error))
+                    break;
+                prev = input;
+            }
+            return complete_prefix_end(begin,p);
+        }
+
+        [[gnu::target("avx2")]]
+        const char* validate_blocks_avx2(const char* p,const char* e) noexcept
+        {
+            const char* begin = p;
+            const __m256i byte_1_high = _mm256_broadcastsi128_si256(
+                              _mm_load_si128(reinterpret_cast<const __m128i*>(byte_1_high_table))),
+                          byte_1_low = _mm256_broadcastsi128_si256(
+                              _mm_load_si128(reinterpret_cast<const __m128i*>(byte_1_low_table))),
+                          byte_2_high = _mm256_broadcastsi128_si256(
+                              _mm_load_si128(reinterpret_cast<const __m128i*>(byte_2_high_table))),
+                          low_nibble = _mm256_set1_epi8(0x0f),
+                          max_value = _mm256_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+                                                       -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+                                                       char(0xf0-1),char(0xe0-1),char(0xc0-1));
+            __m256i prev = _mm256_setzero_si256(),
+                    prev_incomplete = _mm256_setzero_si256();
+            for(;e-p>=32;p+=32){
+                __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)),
+                        error;
+                if(!_mm256_movemask_epi8(input))
+                    error = prev_incomplete;
+                else{
+                    // Previous block's high lane followed by input's low lane, for byte shifts across lanes.
+                    __m256i shifted = _mm256_permute2x128_si256(prev,input,0x21),
+                            prev1 = _mm256_alignr_epi8(input,shifted,16-1),
+                            special_cases = _mm256_and_si256(_mm256_and_si256(
+                                _mm256_shuffle_epi8(byte_1_high,_mm256_and_si256(_mm256_srli_epi16(prev1,4),low_nibble)),
+                                _mm256_shuffle_epi8(byte_1_low,_mm256_and_si256(prev1,low_nibble))),
+                                _mm256_shuffle_epi8(byte_2_high,_mm256_and_si256(_mm256_srli_epi16(input,4),low_nibble))),
+                            must_be_continuation = _mm256_or_si256(
+                                _mm256_subs_epu8(_mm256_alignr_epi8(input,shifted,16-2),
+                                                 _mm256_set1_epi8(char(0xe0-0x80))),
+                                _mm256_subs_epu8(_mm256_alignr_epi8(input,shifted,16-3),
+                                                 _mm256_set1_epi8(char(0xf0-0x80))));
+                    error = _mm256_xor_si256(_mm256_and_si256(must_be_continuation,_mm256_set1_epi8(char(0x80))),
+                                             special_cases);
+                    prev_incomplete = _mm256_subs_epu8(input,max_value);
+                }
+                if(!_mm256_testz_si256(error,error))
+                    break;
+                prev = input;
+            }
+            return complete_prefix_end(begin,p);
+        }
+
+        using validate_blocks_t = const char* (*)(const char*,const char*) noexcept;
+
+        validate_blocks_t select_validate_blocks() noexcept
+        {
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx2"))
+                return validate_blocks_avx2;
+            if(__builtin_cpu_supports("sse4.1"))
+                return validate_blocks_sse41;
+            return nullptr;
+        }
+
+        const validate_blocks_t validate_blocks = select_validate_blocks();
+#endif
+
+        // Skips 8 bytes at a time while they are all ASCII.
+        const char* skip_ascii(const char* p,const char* e) noexcept
+        {
+            for(uint64_t w;e-p>=8;p+=8){
+                std::memcpy(&w,p,8);
+                if(w&0x8080808080808080u)
+                    break;
+            }
+            return p;
+        }
+    }
+
     const char* utf8_validator::validate(string_view sv) noexcept
     {
         utf8_validator v;
@@ -80,11 +285,26 @@ namespace ampi
             0xff,0x30,0x30,0x30,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
             0xff,0x30,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff
         };
+        const char* p = sv.data();
+        const char* e = p+sv.size();
         uint8_t s = state_;
-        for(size_t i=0;i<sv.size();++i){
-            s = transitions[s+classes[uint8_t(sv[i])]];
+        // Finish a sequence continued from previous piece.
+        for(;s&&p!=e;++p)
+            if((s = transitions[s+classes[uint8_t(*p)]])==0xff)
+                return p;
+#ifdef AMPI_UTF8_VALIDATOR_X86_SIMD
+        // Blocks with errors and the tail shorter than a block are left for the table below,
+        // which also finds exact error position.
+        if(validate_blocks&&p!=e)
+            p = validate_blocks(p,e);
+#endif
+        while(p!=e){
+            if(!s&&(p = skip_ascii(p,e))==e)
+                break;
+            s = transitions[s+classes[uint8_t(*p)]];
             if(s==0xff)
-                return &sv[i];
+                return p;
+            ++p;
         }
         state_ = s;
         return nullptr;
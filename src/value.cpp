@@ -6,6 +6,8 @@
 
 #include <ampi/value.hpp>
 
+#include <ampi/msgpack.hpp>
+#include <ampi/filters/span_parser.hpp>
 #include <ampi/utils/repeated.hpp>
 
 #include <boost/io/ios_state.hpp>
@@ -61,6 +63,11 @@ namespace ampi
             stream_ << "null";
         }
 
+        void operator()(const cached_value& x) const
+        {
+            visit(*this,x->v);
+        }
+
         void operator()(const sequence& x) const
         {
             stream_ << '[';
@@ -68,10 +75,10 @@ namespace ampi
                 auto new_indent = current_indent_+indent;
                 stream_ << '\n' << repeated(new_indent);
                 auto it = x.begin(),e = x.end();
-                visit(print_visitor{stream_,new_indent},it++->v_);
+                visit(print_visitor{stream_,new_indent},it++->plain());
                 for(;it!=e;++it){
                     stream_ << ",\n" << repeated(new_indent);
-                    visit(print_visitor{stream_,new_indent},it->v_);
+                    visit(print_visitor{stream_,new_indent},it->plain());
                 }
                 stream_ << '\n' << repeated(current_indent_);
             }
@@ -85,14 +92,14 @@ namespace ampi
                 auto new_indent = current_indent_+indent;
                 stream_ << '\n' << repeated(new_indent);
                 auto it = x.begin(),e = x.end();
-                visit(print_visitor{stream_,new_indent},it->first.v_);
+                visit(print_visitor{stream_,new_indent},it->first.plain());
                 stream_ << " : ";
-                visit(print_visitor{stream_,new_indent},it++->second.v_);
+                visit(print_visitor{stream_,new_indent},it++->second.plain());
                 for(;it!=e;++it){
                     stream_ << ",\n" << repeated(new_indent);
-                    visit(print_visitor{stream_,new_indent},it->first.v_);
+                    visit(print_visitor{stream_,new_indent},it->first.plain());
                     stream_ << " : ";
-                    visit(print_visitor{stream_,new_indent},it->second.v_);
+                    visit(print_visitor{stream_,new_indent},it->second.plain());
                 }
                 stream_ << '\n' << repeated(current_indent_);
             }
@@ -110,11 +117,24 @@ namespace ampi
         }
     };
 
+    void value::cache_encoding()
+    {
+        if(cached_encoding())
+            return;
+        size_t n = msgpack_size(*this);
+        if(n>cbuffer::max_size)
+            return;
+        buffer buf{n};
+        msgpack_to(buf.view(),*this);
+        auto node = std::make_shared<cached_node>(cached_node{std::move(v_),std::move(buf)});
+        v_ = std::move(node);
+    }
+
     std::ostream& operator<<(std::ostream& stream,const value& v)
     {
         boost::io::ios_flags_saver ifs{stream};
         stream << std::boolalpha;
-        visit(value::print_visitor{stream},v.v_);
+        visit(value::print_visitor{stream},v.plain());
         return stream;
     }
 
@@ -123,6 +143,15 @@ namespace ampi
         delegating_event_generator value_se_source::operator()(pmr_system_executor ex,
                                                                const value& v) const
         {
+            // Event sinks consume this as well, so the cached encoding is parsed back
+            // into events referring to it rather than yielded as one data chunk,
+            // which emitters would have no way to tell from string or binary data.
+            if(auto c = v.cached_encoding()){
+                span_parser sp{*c,parser_option::skip_utf8_validation};
+                while(event* e = sp.next())
+                    co_yield std::move(*e);
+                co_return;
+            }
             switch(v.kind()){
                 case object_kind::map:
                     co_yield serial_event_source(type_tag<map>)(ex,*v.get_if<map>());
@@ -159,8 +188,8 @@ namespace ampi
                     }
                     break;
                 default:
-                    co_yield v.v_.subset<std::nullptr_t,bool,uint64_t,int64_t,
-                                         float,double,timestamp_t>();
+                    co_yield v.plain().subset<std::nullptr_t,bool,uint64_t,int64_t,
+                                              float,double,timestamp_t>();
             }
         }
     }
@@ -6,24 +6,38 @@
 
 #include <ampi/tests/ut_helpers.hpp>
 
+#include <ampi/async_broadcast.hpp>
 #include <ampi/async_msgpack.hpp>
 #include <ampi/async_msgunpack.hpp>
+#include <ampi/buffer_sinks/container_buffer_sink.hpp>
+#include <ampi/buffer_sources/borrowing_buffer_source.hpp>
+#include <ampi/buffer_sources/mmap_buffer_source.hpp>
 #include <ampi/event_sinks/hana_struct.hpp>
 #include <ampi/event_sinks/pfr_tuple.hpp>
 #include <ampi/event_sources/hana_struct.hpp>
 #include <ampi/event_sources/pfr_tuple.hpp>
+#include <ampi/filters/message_validator.hpp>
+#include <ampi/filters/push_parser.hpp>
+#include <ampi/filters/span_parser.hpp>
 #include <ampi/istream.hpp>
+#include <ampi/lazy_document.hpp>
 #include <ampi/msgpack.hpp>
 #include <ampi/ostream.hpp>
 #include <ampi/transmute.hpp>
+#include <ampi/utf8_validator.hpp>
 #include <ampi/value.hpp>
 
 #include <boost/asio/local/connect_pair.hpp>
 #include <boost/asio/local/stream_protocol.hpp>
 #include <boost/hana/adapt_struct.hpp>
 
+#include <array>
+#include <deque>
+#include <fstream>
+#include <functional>
 #include <map>
 #include <set>
+#include <thread>
 #include <unordered_map>
 
 struct hana_test
@@ -55,6 +69,15 @@ private:
 
 AMPI_ADAPT_CLASS(hana_test3,x);
 
+struct hana_test4
+{
+    int a;
+};
+BOOST_HANA_ADAPT_STRUCT(hana_test4,a);
+
+template<>
+struct ampi::ignore_unknown_keys<hana_test4> : std::true_type {};
+
 struct pfr_test
 {
     std::string x;
@@ -163,6 +186,23 @@ namespace ampi { namespace
                 transmute<hana_test>(hana_test2{});
             }));
             test_roundtrip(hana_test3{42});
+            {
+                string_view s = "\x83\xa2""zz\x92\x01\x81\xa1""q\xa1""s\xa1""a\x2a\xa1""b\xc4\x01\x00";
+                auto h = msgunpack<hana_test4>({reinterpret_cast<const byte*>(s.data()),s.size()});
+                expect(h.a==42_i);
+                std::stringstream ss{std::string{s}};
+                h.a = 0;
+                ss >> as_msgpack(h);
+                expect(h.a==42_i);
+                // Skipping by the stream parser, including the last value of an object,
+                // leaves it at the start of the next one.
+                std::stringstream ss2{std::string{s}+"\x81\xa1""a\x07"};
+                istream_msgpack_ctx<readahead_t::none> ictx{ss2};
+                hana_test4 h2;
+                h.a = 0;
+                ictx >> h >> h2;
+                expect(h.a==42_i&&h2.a==7_i);
+            }
         };
         "pfr"_test = []{
             test_roundtrip(pfr_test{"test",123u});
@@ -190,6 +230,13 @@ namespace ampi { namespace
                 if(e)
                     expect(that%x==*e);
             }
+            {
+                span_parser sp{binary_cview_t{reinterpret_cast<const byte*>(s.data()),s.size()}};
+                auto e = sp.next();
+                expect(e!=nullptr_v);
+                if(e)
+                    expect(that%x==*e);
+            }
             {
                 detail::stack_executor_ctx ctx;
                 auto ses = [](pmr_system_executor,event e) -> noexcept_event_generator {
@@ -214,6 +261,7 @@ namespace ampi { namespace
             auto r = std::move(ss).str();
             expect(that%printable_binary_cspan_t{s}==printable_binary_cspan_t{r});
             expect(that%printable_binary_cspan_t{s}==printable_binary_cspan_t{msgpack(x)});
+            expect(msgpack_size(x)==s.size());
             expect(x==msgunpack<T>({reinterpret_cast<const byte*>(s.data()),s.size()}));
             boost::asio::io_context ctx;
             boost::asio::local::stream_protocol::socket from{ctx},to{ctx};
@@ -423,5 +471,617 @@ namespace ampi { namespace
             {"ghi",{{12,-2,true}}},
             {"test",nullptr}
         }}},"\x84\xa3""abc""\xc3\xa4""defg""\xfd\xa3""ghi""\x93\x0c\xfe\xc3\xa4""test""\xc0");
+        "span_parser"_test = []{
+            constexpr auto bytes = [](string_view s){
+                return binary_cview_t{reinterpret_cast<const byte*>(s.data()),s.size()};
+            };
+            span_parser sp{bytes("\x92\xa2""ab\xc3\x2a")};
+            vector<event> events;
+            sp([&](event e){
+                events.push_back(std::move(e));
+            });
+            expect(events.size()==4_u);
+            expect(sp.rest().size()==1_u);
+            expect(throws<parser_error>([&]{
+                msgunpack<value>(bytes("\x92\xa2""ab"));
+            }));
+            expect(throws<parser_error>([&]{
+                msgunpack<string>(bytes("\xa1\xff"));
+            }));
+        };
+        "batched"_test = []{
+            string_view s = "\x94\x01\x02\x03\x04";
+            binary_cview_t bytes{reinterpret_cast<const byte*>(s.data()),s.size()};
+            null_buffer_factory bf;
+            detail::stack_executor_ctx ctx;
+            std::array<event,2> batch;
+            {
+                auto oss = one_buffer_source(bytes);
+                parser p{oss,bf,{},ctx.ex};
+                auto p_b = p.batched(batch).assume_blocking();
+                vector<size_t> sizes;
+                while(auto b = p_b())
+                    sizes.push_back(b->size());
+                expect(sizes==vector<size_t>{2,2,1});
+            }
+            {
+                auto oss = one_buffer_source(bytes);
+                parser p{oss,bf,{},ctx.ex};
+                auto p_b = p.batched(batch);
+                batched_event_source bes{p_b};
+                vector<int> v;
+                auto sink = serial_event_sink(type_tag<vector<int>>)(ctx.ex,bes,v).assume_blocking();
+                sink();
+                expect(v==vector<int>{1,2,3,4});
+            }
+        };
+        "packing_emitter"_test = []{
+            detail::stack_executor_ctx ctx;
+            std::array<byte,300> big{};
+            auto ses = [](pmr_system_executor,binary_cview_t big) -> noexcept_event_generator {
+                co_yield sequence_header{3};
+                co_yield uint64_t(1000);
+                co_yield string_header{2};
+                co_yield cbuffer{binary_cview_t{reinterpret_cast<const byte*>("ab"),2}};
+                co_yield binary_header{uint32_t(big.size())};
+                co_yield cbuffer{big};
+            }(ctx.ex,big);
+            pmr_buffer_factory bf;
+            auto em = packing_emitter(ctx.ex,ses,bf).assume_blocking();
+            auto buf = em();
+            expect(buf!=nullptr_v);
+            if(buf)
+                expect(that%printable_binary_cspan_t{buf->view()}==
+                    printable_binary_cspan_t{"\x93\xcd\x03\xe8\xa2""ab\xc5\x01\x2c"});
+            buf = em();
+            expect(buf!=nullptr_v);
+            if(buf)
+                expect(buf->data()==big.data());
+            expect(em()==nullptr_v);
+        };
+        "pooled_buffer_factory"_test = []{
+            pooled_buffer_factory bf{0x1000};
+            expect(bf.get_buffer().size()==0x1000-sizeof(detail::buffer_header));
+            cbuffer cb = bf.get_buffer(10);
+            std::thread{[cb = std::move(cb)]() mutable {
+                cb = {};
+            }}.join();
+            buffer b = bf.get_buffer(0x1800);
+            expect(b.size()==0x2000-sizeof(detail::buffer_header));
+            b = bf.get_buffer();
+            auto s = bf.stats();
+            expect(s.hits==2&&s.misses==2);
+        };
+        "mmap_buffer_source"_test = []{
+            vector<string> v{string(3000,'a'),string(3000,'b'),string(3000,'c')};
+            auto path = std::filesystem::temp_directory_path()/"ampi_mmap_buffer_source.msgpack";
+            {
+                auto s = msgpack(v);
+                std::ofstream{path,std::ios::binary}.write(reinterpret_cast<const char*>(s.data()),
+                                                           std::streamsize(s.size()));
+            }
+            pmr_buffer_factory bf;
+            detail::stack_executor_ctx ctx;
+            for(size_t window:{size_t(0),mapped_file::page_size()}){
+                auto mbs = mmap_buffer_source(ctx.ex,path,{.window_size = window});
+                parser p{mbs,bf,{},ctx.ex};
+                auto p_e = p();
+                vector<string> w;
+                auto sink = serial_event_sink(type_tag<vector<string>>)(ctx.ex,p_e,w).assume_blocking();
+                sink();
+                expect(w==v);
+            }
+            cbuffer whole;
+            {
+                auto mbs = mmap_buffer_source(path);
+                whole = *mbs();
+            }
+            std::filesystem::remove(path);
+            expect(whole.size()==9010_u);
+            expect(whole[whole.size()-1]==byte{'c'});
+        };
+        "cbuffer"_test = []{
+            pmr_buffer_factory bf;
+            buffer b = bf.get_buffer(4);
+            std::memcpy(b.data(),"abcd",4);
+            cbuffer owned{b,2},unowned{b.view().first(2)};
+            expect(unowned.append(owned));
+            expect(unowned.allocator()!=nullptr&&!owned);
+            b = {};
+            expect(that%printable_binary_cspan_t{unowned.view()}==printable_binary_cspan_t{"abcd"});
+            cbuffer slice{unowned,1,2};
+            expect(slice.size()==2_u&&slice[0]==byte{'b'});
+            expect(throws<std::length_error>([]{
+                (void)buffer{size_t(cbuffer::max_size)+1};
+            }));
+        };
+        "buffer_ownership"_test = []{
+            pmr_buffer_factory pbf;
+            single_threaded_buffer_factory bf{pbf};
+            buffer b = bf.get_buffer(3);
+            std::memcpy(b.data(),"\xa2""ab",3);
+            {
+                cbuffer c{b,1};
+                expect(c.allocator()!=nullptr);
+            }
+            detail::stack_executor_ctx ctx;
+            auto bs = [](pmr_system_executor,cbuffer c) -> noexcept_generator<cbuffer,pmr_system_executor> {
+                co_yield std::move(c);
+            }(ctx.ex,{std::move(b),0,3});
+            borrowed_buffers kept;
+            auto bbs = borrowing_buffer_source(ctx.ex,bs,kept);
+            parser p{bbs,bf,{},ctx.ex};
+            auto p_e = p().assume_blocking();
+            expect(p_e()!=nullptr_v);
+            auto e = p_e();
+            expect(e!=nullptr_v);
+            if(e){
+                auto data = e->get_if<cbuffer>();
+                expect(data&&!data->allocator()&&data->size()==2);
+                if(data){
+                    kept.release_before(*data);
+                    expect(!kept.empty()&&(*data)[0]==byte{'a'});
+                }
+            }
+            kept.release();
+            expect(kept.empty());
+        };
+        "growing_buffer_factory"_test = []{
+            pmr_buffer_factory pbf;
+            growing_buffer_factory bf{pbf,0x400};
+            expect(bf.get_buffer(0x100).size()==0x100_u);
+            expect(bf.get_buffer(0x100).size()==0x200_u);
+            expect(bf.get_buffer(0x100).size()==0x400_u);
+            expect(bf.get_buffer(0x100).size()==0x400_u);
+            expect(bf.get_buffer(0x800).size()==0x800_u);
+        };
+        "adaptive_readahead"_test = []{
+            boost::asio::io_context ctx;
+            boost::asio::local::stream_protocol::socket from{ctx},to{ctx};
+            boost::asio::local::connect_pair(from,to);
+            vector<string> x{string(100000,'a'),"b"};
+            async_msgpack(to,x,[&](result<void> r){
+                r.value();
+            });
+            vector<string> z;
+            {
+                async_stream_msgunpack_ctx<boost::asio::local::stream_protocol::socket,
+                                           readahead_t::adaptive> amc{from};
+                amc.async_msgunpack(z,[&](result<void> r){
+                    r.value();
+                });
+                ctx.run();
+            }
+            expect(x==z);
+            expect(!from.non_blocking());
+        };
+        "pipelined_stream_buffer_source"_test = []{
+            boost::asio::io_context ctx;
+            boost::asio::local::stream_protocol::socket from{ctx},to{ctx};
+            boost::asio::local::connect_pair(from,to);
+            vector<string> x{string(100000,'a'),"b"};
+            async_msgpack(to,x,[&](result<void> r){
+                r.value();
+                to.close();
+            });
+            vector<string> z;
+            [](executor auto,auto& from,vector<string>& z)
+                    -> coroutine<void,boost::asio::io_context::executor_type> {
+                pmr_buffer_factory bf{0x1000};
+                detail::stack_executor_ctx ctx;
+                auto psbs = pipelined_stream_buffer_source(from,bf);
+                parser p{psbs,bf,{},ctx.ex};
+                auto p_v = p();
+                co_await serial_event_sink(type_tag<vector<string>>)(ctx.ex,p_v,z);
+            }(ctx.get_executor(),from,z).async_run([](result<void> r){
+                r.value();
+            });
+            ctx.run();
+            expect(x==z);
+        };
+        "double_buffer_sink"_test = []{
+            boost::asio::io_context ctx;
+            boost::asio::local::stream_protocol::socket from{ctx},to{ctx};
+            boost::asio::local::connect_pair(from,to);
+            vector<string> x(64,string(10000,'a'));
+            for(size_t i=0;i<x.size();++i)
+                x[i][i] = 'b';
+            async_stream_msgpack_ctx<boost::asio::local::stream_protocol::socket,
+                                     boost::container::static_vector<cbuffer,2>> amc{to};
+            amc.async_msgpack(x,[&](result<void> r){
+                r.value();
+                amc.async_msgpack(x,[&](result<void> r){
+                    r.value();
+                });
+            });
+            vector<string> y,z;
+            async_stream_msgunpack_ctx amuc{from};
+            amuc.async_msgunpack(y,[&](result<void> r){
+                r.value();
+                amuc.async_msgunpack(z,[&](result<void> r){
+                    r.value();
+                });
+            });
+            ctx.run();
+            expect(x==y);
+            expect(x==z);
+        };
+        "async_stream_msgpack_writer"_test = []{
+            boost::asio::io_context ctx;
+            boost::asio::local::stream_protocol::socket from{ctx},to{ctx};
+            boost::asio::local::connect_pair(from,to);
+            async_stream_msgpack_writer writer{to};
+            constexpr unsigned n = 100;
+            vector<std::pair<unsigned,unsigned>> x(2*n);
+            unsigned completed = 0;
+            auto send = [&](unsigned t){
+                for(unsigned i=0;i<n;++i){
+                    x[t*n+i] = {t,i};
+                    writer.async_msgpack(x[t*n+i],[&](result<void> r){
+                        r.value();
+                        ++completed;
+                    });
+                }
+            };
+            std::thread thread{send,1};
+            send(0);
+            thread.join();
+            async_stream_msgunpack_ctx amuc{from};
+            std::pair<unsigned,unsigned> y;
+            unsigned next[2] = {};
+            std::function<void ()> receive = [&]{
+                amuc.async_msgunpack(y,[&](result<void> r){
+                    r.value();
+                    expect(y.second==next[y.first]++);
+                    if(next[0]+next[1]<2*n)
+                        receive();
+                });
+            };
+            receive();
+            ctx.run();
+            expect(completed==2*n);
+            expect(next[0]==n&&next[1]==n);
+        };
+        "flush_policy"_test = []{
+            boost::asio::io_context ctx;
+            boost::asio::local::stream_protocol::socket from{ctx},to{ctx};
+            boost::asio::local::connect_pair(from,to);
+            async_stream_msgpack_writer writer{to,{.max_messages = 4,
+                                                   .max_delay = std::chrono::milliseconds{10}}};
+            vector<unsigned> x(10);
+            unsigned sent = 0,completed = 0;
+            auto send = [&](unsigned n){
+                for(;n;--n,++sent){
+                    x[sent] = sent;
+                    writer.async_msgpack(x[sent],[&](result<void> r){
+                        r.value();
+                        ++completed;
+                    });
+                }
+                ctx.run();
+                ctx.restart();
+            };
+            send(3);
+            expect(completed==3);
+            expect(writer.stats().deadline==1);
+            send(5);
+            expect(completed==8);
+            expect(writer.stats().messages==1);
+            writer.flush();
+            expect(writer.stats().requested==0);
+            x[sent] = sent;
+            writer.async_msgpack(x[sent++],[&](result<void> r){
+                r.value();
+                ++completed;
+            });
+            writer.flush();
+            send(0);
+            auto st = writer.stats();
+            expect(completed==9);
+            expect(st.requested==1&&st.bytes==0);
+            async_stream_msgunpack_ctx amuc{from};
+            unsigned y,next = 0;
+            std::function<void ()> receive = [&]{
+                amuc.async_msgunpack(y,[&](result<void> r){
+                    r.value();
+                    expect(y==next++);
+                    if(next<9)
+                        receive();
+                });
+            };
+            receive();
+            ctx.run();
+            expect(next==9);
+        };
+        "async_broadcast"_test = []{
+            using socket = boost::asio::local::stream_protocol::socket;
+            boost::asio::io_context ctx;
+            socket from0{ctx},from1{ctx},from2{ctx},to0{ctx},to1{ctx},to2{ctx};
+            boost::asio::local::connect_pair(from0,to0);
+            boost::asio::local::connect_pair(from1,to1);
+            boost::asio::local::connect_pair(from2,to2);
+            vector<string> x{string(0x400000,'a'),"b"};
+            encoded_message msg;
+            {
+                auto y = x;
+                msg = encoded_message{y};
+            }
+            expect(msg.size()==msgpack_size(x));
+            vector<socket*> tos{&to0,&to1,&to2};
+            vector<size_t> written;
+            vector<boost::system::error_code> results;
+            // Nothing reads from2, so its write never finishes.
+            async_broadcast(tos,msg,{.timeout = std::chrono::milliseconds{200},
+                                     .on_written = [&](size_t i,boost::system::error_code){
+                                         written.push_back(i);
+                                     }},
+                            [&](vector<boost::system::error_code> r){
+                                results = std::move(r);
+                            });
+            vector<string> z0,z1;
+            async_msgunpack(from0,z0,[&](result<void> r){
+                r.value();
+            });
+            async_msgunpack(from1,z1,[&](result<void> r){
+                r.value();
+            });
+            ctx.run();
+            expect(z0==x&&z1==x);
+            expect(written.size()==3&&written.back()==2);
+            expect(results.size()==3);
+            if(results.size()==3){
+                expect(!results[0]&&!results[1]);
+                expect(results[2]==boost::asio::error::timed_out);
+            }
+        };
+        "value_encoding_cache"_test = []{
+            value v{map{{"static",sequence{1,"abc",2.5}},{"dynamic",-3}}};
+            auto s = msgpack(v);
+            v.get_if<map>()->at("static").cache_encoding();
+            expect(v.get_if<map>()->at("static").cached_encoding()!=nullptr_v);
+            expect(that%printable_binary_cspan_t{s}==printable_binary_cspan_t{msgpack(v)});
+            expect(msgpack_size(v)==s.size());
+            v.cache_encoding();
+            auto c = std::as_const(v).cached_encoding();
+            expect(c!=nullptr_v);
+            if(c)
+                expect(that%printable_binary_cspan_t{s}==printable_binary_cspan_t{c->view()});
+            std::stringstream ss;
+            ss << as_msgpack(v);
+            auto r = std::move(ss).str();
+            expect(that%printable_binary_cspan_t{s}==printable_binary_cspan_t{r});
+            expect(msgunpack({s.data(),s.size()})==v);
+            expect(std::as_const(v).get_if<map>()!=nullptr_v);
+            expect(std::as_const(v).cached_encoding()==c);
+            value u = v;
+            expect(std::as_const(u).cached_encoding()==c);
+            u.get_if<map>()->erase("dynamic");
+            expect(std::as_const(u).cached_encoding()==nullptr_v);
+            expect(std::as_const(v).cached_encoding()==c&&u!=v);
+            v.get_if<map>()->at("static").get_if<sequence>()->push_back(4);
+            expect(std::as_const(v).cached_encoding()==nullptr_v);
+            value w{map{{"static",sequence{1,"abc",2.5,4}},{"dynamic",-3}}};
+            expect(that%printable_binary_cspan_t{msgpack(w)}==printable_binary_cspan_t{msgpack(v)});
+        };
+        "utf8"_test = []{
+            std::string s;
+            for(int i=0;i<20;++i)
+                s += "ascii text \xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80";
+            expect(!utf8_validator::validate(s));
+            for(size_t piece:{1u,5u,16u,33u}){
+                utf8_validator v;
+                for(size_t i=0;i<s.size();i+=piece)
+                    expect(!v(string_view{s}.substr(i,piece)));
+                expect(bool(v));
+            }
+            std::string bad = s;
+            bad[200] = '\xff';
+            expect(utf8_validator::validate(bad)==bad.data()+200);
+            bad = s.substr(0,s.size()-1);
+            expect(utf8_validator::validate(bad)==bad.data()+bad.size());
+        };
+        "messages"_test = []{
+            string_view s = "\x01\x92\x02\x03\xa1""a";
+            null_buffer_factory bf;
+            detail::stack_executor_ctx ctx;
+            auto oss = one_buffer_source(binary_cview_t{reinterpret_cast<const byte*>(s.data()),s.size()});
+            parser p{oss,bf,{},ctx.ex};
+            auto p_m = p.messages().assume_blocking();
+            vector<size_t> sizes;
+            size_t n = 0;
+            for(;;)
+                if(p_m())
+                    ++n;
+                else if(p_m){
+                    sizes.push_back(n);
+                    n = 0;
+                }else
+                    break;
+            expect(sizes==vector<size_t>{1,3,2});
+            std::stringstream ss{std::string{s}};
+            istream_msgpack_ctx<readahead_t::none> imc{ss};
+            int x;
+            vector<int> v;
+            string str;
+            imc >> x >> v >> str;
+            expect(x==1_i);
+            expect(v==vector<int>{2,3});
+            expect(str=="a");
+            // Input ending before the next object is still an unexpected end, every time.
+            expect(throws<parser_error>([&]{
+                imc >> x;
+            }));
+            expect(throws<parser_error>([&]{
+                imc >> x;
+            }));
+            // Input arriving after the end is read once the stream is usable again.
+            ss.clear();
+            ss.seekp(0,std::ios::end);
+            ss << '\x04';
+            imc >> x;
+            expect(x==4_i);
+            // The rest of an object a sink has given up on is dropped.
+            std::stringstream ss2{std::string{"\x92\x01\xa1""a\x05",5}};
+            istream_msgpack_ctx<readahead_t::none> imc2{ss2};
+            expect(throws<structure_error>([&]{
+                imc2 >> v;
+            }));
+            imc2 >> x;
+            expect(x==5_i);
+        };
+        "push_parser"_test = []{
+            string_view s = "\x94\x01\xa2""ab\x03\xc0";
+            push_parser pp;
+            vector<event> events;
+            size_t need = 1;
+            for(size_t i=0;i<s.size()-1;++i)
+                need = pp.feed(binary_cview_t{reinterpret_cast<const byte*>(s.data()+i),1},[&](event e){
+                    events.push_back(std::move(e));
+                });
+            expect(need==1_u);
+            expect(events.size()==6_u);
+            need = pp.feed(binary_cview_t{reinterpret_cast<const byte*>(s.data()+s.size()-1),1},
+                           [&](event e){
+                events.push_back(std::move(e));
+            });
+            expect(need==0_u);
+            expect(pp.done());
+            pp.reset();
+            detail::stack_executor_ctx ctx;
+            push_event_source pes;
+            vector<int> v;
+            bool finished = false;
+            serial_event_sink(type_tag<vector<int>>)(ctx.ex,pes,v).async_run([&](result<void> r){
+                r.value();
+                finished = true;
+            });
+            string_view s2 = "\x93\x01\x02\x03";
+            for(size_t i=0;i<s2.size();++i)
+                pp.feed(binary_cview_t{reinterpret_cast<const byte*>(s2.data()+i),1},pes);
+            expect(finished);
+            expect(v==vector<int>{1,2,3});
+        };
+        "message_validator"_test = []{
+            constexpr auto bytes = [](string_view s){
+                return binary_cview_t{reinterpret_cast<const byte*>(s.data()),s.size()};
+            };
+            using status = message_boundary::status_t;
+            string_view s = "\x92\xa2""ab\xc4\x01\x00\x01";
+            auto b = find_message_end(bytes(s));
+            expect(b.status==status::complete&&b.length==7_u);
+            b = find_message_end(bytes(s.substr(0,4)));
+            expect(b.status==status::incomplete&&b.length==1_u);
+            b = find_message_end(bytes("\x91\xa1\xff"));
+            expect(b.status==status::malformed&&b.reason==parser_error::reason_t::invalid_utf8);
+            b = find_message_end(bytes("\xc1"));
+            expect(b.status==status::malformed&&b.reason==parser_error::reason_t::invalid_leading_byte);
+            message_validator mv;
+            size_t end = 0;
+            for(size_t i=0;i<s.size();++i){
+                b = mv.feed(bytes(s.substr(i,1)));
+                if(b.status==status::complete){
+                    end = i+b.length;
+                    break;
+                }
+            }
+            expect(end==7_u);
+        };
+        "lazy_document"_test = []{
+            string_view s = "\x83\xa4""user\x81\xa2""id\x2a\xa1""x\x01\xa1""s\x92\xa2""hi\xc3";
+            lazy_document doc{cbuffer{binary_cview_t{reinterpret_cast<const byte*>(s.data()),s.size()}}};
+            expect(doc.root().size()==3_u);
+            expect(doc["user"]["id"].as<int>()==42_i);
+            expect(doc["s"][0].as<string_view>()=="hi");
+            expect(doc["s"][1].as<bool>());
+            expect(doc["s"].as<vector<value>>()==vector<value>{"hi",true});
+            expect(!doc.find("y"));
+            expect(throws<structure_error>([&]{
+                doc["s"][2];
+            }));
+            expect(throws<structure_error>([&]{
+                doc["x"]["id"];
+            }));
+            // Parts of a truncated document before the cut are still accessible.
+            string_view t = s.substr(0,s.size()-2);
+            lazy_document tdoc{cbuffer{binary_cview_t{reinterpret_cast<const byte*>(t.data()),t.size()}}};
+            expect(tdoc["user"]["id"].as<int>()==42_i);
+            expect(throws<parser_error>([&]{
+                tdoc["s"][0].as<string_view>();
+            }));
+            vector<int> seq(100);
+            for(int i=0;i<100;++i)
+                seq[size_t(i)] = i*1000;
+            auto es = msgpack(seq);
+            lazy_document sdoc{cbuffer{binary_cview_t{es.data(),es.size()}}};
+            bool ok = true;
+            for(uint32_t i=100;i--;)
+                ok = ok&&sdoc[i].as<int>()==int(i)*1000;
+            expect(ok&&sdoc[50].as<int>()==50000_i);
+        };
+        "direct_encoder"_test = []{
+            static_assert(direct_encodable<hana_test>&&direct_encodable<pfr_test>&&
+                          direct_encodable<std::map<string,vector<optional<int>>>>);
+            auto check = [](const auto& x,string_view s){
+                using T = std::remove_cvref_t<decltype(x)>;
+                vector<byte> evented;
+                detail::stack_executor_ctx ctx;
+                auto ses = serial_event_source(type_tag<T>)(ctx.ex,x);
+                detail::fixed_msgpack_buffer_factory bf;
+                auto em = emitter(ctx.ex,ses,bf);
+                auto sink = container_buffer_sink(ctx.ex,evented,em).assume_blocking();
+                sink();
+                expect(that%printable_binary_cspan_t{s}==printable_binary_cspan_t{evented});
+                expect(that%printable_binary_cspan_t{s}==printable_binary_cspan_t{msgpack(x)});
+                expect(msgpack_size(x)==s.size());
+            };
+            check(hana_test{true,-45,"test"},"\x83\xa3""abc\xc3\xa3""def\xd0\xd3\xa6""ghijkl\xa4""test");
+            check(hana_test3{7},"\x81\xa1""x\x07");
+            check(pfr_test{"x",300u},"\x92\xa1""x\xcd\x01\x2c");
+        };
+        "msgpack_to"_test = []{
+            auto check = [](const auto& x,string_view s){
+                vector<byte> out(s.size()+1);
+                binary_view_t view{out.data(),out.size()};
+                expect(msgpack_to(view,x)==s.size());
+                expect(that%printable_binary_cspan_t{s}==printable_binary_cspan_t{view.first(s.size())});
+                expect(msgpack_to(view.first(s.size()-1),x)==s.size());
+                vector<byte> cont{byte{0xc0}};
+                msgpack(cont,x);
+                expect(that%printable_binary_cspan_t{"\xc0"+std::string{s}}==
+                    printable_binary_cspan_t{cont});
+                std::deque<byte> dq{byte{0xc0}};
+                msgpack(dq,x);
+                vector<byte> flat(dq.begin(),dq.end());
+                expect(that%printable_binary_cspan_t{"\xc0"+std::string{s}}==
+                    printable_binary_cspan_t{flat});
+            };
+            check(hana_test{true,-45,"test"},"\x83\xa3""abc\xc3\xa3""def\xd0\xd3\xa6""ghijkl\xa4""test");
+            check(value{{{{"abc",true},{"defg",-3}}}},"\x82\xa3""abc\xc3\xa4""defg\xfd");
+        };
+        "direct_decoder"_test = []{
+            static_assert(direct_decodable<hana_test>&&direct_decodable<hana_test3>&&
+                          direct_decodable<pfr_test>&&direct_decodable<vector<value>>);
+            auto view = [](string_view s){
+                return binary_cview_t{reinterpret_cast<const byte*>(s.data()),s.size()};
+            };
+            expect(msgunpack<hana_test>(view("\x83\xa6""ghijkl\xa4""test\xa3""def\xd0\xd3\xa3""abc\xc3"))==
+                   hana_test{true,-45,"test"});
+            expect(msgunpack<hana_test3>(view("\x81\xa1""x\x07"))==hana_test3{7});
+            expect(msgunpack<pfr_test>(view("\x92\xa1""x\xcd\x01\x2c"))==pfr_test{"x",300u});
+            expect(msgunpack<vector<value>>(view("\x92\xa2""hi\xc3"))==vector<value>{"hi",true});
+            expect(throws<structure_error>([&]{
+                msgunpack<hana_test>(view("\x82\xa3""abc\xc3\xa3""abc\xc2"));
+            }));
+            expect(throws<structure_error>([&]{
+                msgunpack<hana_test>(view("\x81\xa3""abd\xc3"));
+            }));
+            expect(throws<parser_error>([&]{
+                msgunpack<hana_test>(view("\x81\xa3""abc"));
+            }));
+            expect(msgunpack<pfr_test>(view("\x92\xa1""x\xd0\x05"))==pfr_test{"x",5u});
+            expect(throws<structure_error>([&]{
+                msgunpack<pfr_test>(view("\x92\xa1""x\xff"));
+            }));
+        };
     };
 }}